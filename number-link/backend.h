@@ -0,0 +1,245 @@
+#ifndef NUMBER_LINK_BACKEND_H_
+#define NUMBER_LINK_BACKEND_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "minisat/core/Solver.h"
+
+#include "cdcl.h"
+
+// SAT solvers behind one IPASIR-like interface. Instance is a template over
+// the backend and encodes straight into it through a ConstantFolder, so
+// nothing goes through a virtual call and no clause is copied:
+//
+//   Minisat::Var newVar();
+//   bool addClause(const C& c);     // any C with size() and operator[];
+//                                   // false once the clauses contradict
+//   void assume(Minisat::Lit p);    // for the next solve() only
+//   bool solve();                   // whether there is a model, false if
+//                                   // interrupted
+//   bool value(Minisat::Lit p);     // in that model
+//   void interrupt();               // the running or next solve(), from
+//                                   // any thread
+//   BackendStats stats() const;
+//   int nVars(), nClauses(), nAssigns() const;  // for Phase
+//
+// Each keeps one clause buffer that addClause() reuses, so encoding
+// allocates nothing per clause.
+
+// Search counters, or -1 where a backend does not report them.
+struct BackendStats {
+  int64_t conflicts = -1, decisions = -1, propagations = -1;
+
+  // The counters since |before|.
+  BackendStats Since(const BackendStats& before) const {
+    BackendStats d;
+    d.conflicts = conflicts < 0 ? -1 : conflicts - before.conflicts;
+    d.decisions = decisions < 0 ? -1 : decisions - before.decisions;
+    d.propagations =
+        propagations < 0 ? -1 : propagations - before.propagations;
+    return d;
+  }
+};
+
+// A Minisat::Solver, or a subclass such as SimpSolver, which solver() opens
+// up for what only Minisat has: budgets, learnt clauses and simplification.
+template <typename Solver>
+class MinisatBackend {
+ public:
+  Minisat::Var newVar() { return solver_.newVar(); }
+
+  template <typename C>
+  bool addClause(const C& c) {
+    clause_.clear();
+    for (int i = 0; i < static_cast<int>(c.size()); ++i)
+      clause_.push(c[i]);
+    return solver_.addClause(clause_);
+  }
+
+  void assume(Minisat::Lit p) { assumptions_.push(p); }
+
+  bool solve() {
+    bool solved = solver_.solve(assumptions_);
+    assumptions_.clear();
+    solver_.clearInterrupt();
+    return solved;
+  }
+
+  bool value(Minisat::Lit p) const {
+    return solver_.modelValue(p) == l_True;
+  }
+
+  void interrupt() { solver_.interrupt(); }
+
+  BackendStats stats() const {
+    BackendStats s;
+    s.conflicts = solver_.conflicts;
+    s.decisions = solver_.decisions;
+    s.propagations = solver_.propagations;
+    return s;
+  }
+
+  int nVars() const { return solver_.nVars(); }
+  int nClauses() const { return solver_.nClauses(); }
+  int nAssigns() const { return solver_.nAssigns(); }
+
+  Solver& solver() { return solver_; }
+  const Solver& solver() const { return solver_; }
+
+ private:
+  Solver solver_;
+  Minisat::vec<Minisat::Lit> clause_, assumptions_;
+};
+
+// A propagator given after the solver that calls it is built, which passes
+// the calls on once there is one.
+template <typename Propagator>
+struct Deferred {
+  std::unique_ptr<Propagator> propagator;
+
+  template <typename Solver>
+  void Propagate(Solver& solver, int from) {
+    if (propagator)
+      propagator->Propagate(solver, from);
+  }
+};
+
+// CdclSolver with a |Propagator|, which reads the variables of the clauses
+// and so is given by SetPropagator() once they are built. Before that, and
+// with NoPropagator, it is the plain CDCL core.
+template <typename Propagator>
+class CdclBackend {
+ public:
+  CdclBackend() : solver_(propagator_) {}
+
+  // Replaces the propagator from the next solve() on.
+  void SetPropagator(Propagator propagator) {
+    propagator_.propagator.reset(new Propagator(std::move(propagator)));
+  }
+
+  Minisat::Var newVar() { return solver_.NewVar(); }
+
+  template <typename C>
+  bool addClause(const C& c) {
+    clause_.clear();
+    for (int i = 0; i < static_cast<int>(c.size()); ++i)
+      clause_.push_back(c[i]);
+    return solver_.AddClause(clause_);
+  }
+
+  void assume(Minisat::Lit p) { assumptions_.push_back(p); }
+
+  bool solve() {
+    bool solved = solver_.Solve(assumptions_);
+    assumptions_.clear();
+    return solved;
+  }
+
+  bool value(Minisat::Lit p) const { return solver_.ModelValue(p); }
+
+  void interrupt() { solver_.Interrupt(); }
+
+  BackendStats stats() const {
+    auto& stats = solver_.stats();
+    BackendStats s;
+    s.conflicts = stats.conflicts;
+    s.decisions = stats.decisions;
+    s.propagations = stats.propagations;
+    return s;
+  }
+
+  int nVars() const { return solver_.nVars(); }
+  int nClauses() const { return solver_.nClauses(); }
+  int nAssigns() const { return solver_.trail_size(); }
+
+  const CdclSolver<Deferred<Propagator>>& solver() const { return solver_; }
+
+ private:
+  Deferred<Propagator> propagator_;
+  CdclSolver<Deferred<Propagator>> solver_;
+  std::vector<Minisat::Lit> clause_, assumptions_;
+};
+
+#ifdef NUMBER_LINK_HAVE_IPASIR
+// The IPASIR interface, which any incremental solver built for the SAT
+// Race can be linked in through; the build script looks for one.
+extern "C" {
+const char* ipasir_signature();
+void* ipasir_init();
+void ipasir_release(void* solver);
+void ipasir_add(void* solver, int lit_or_zero);
+void ipasir_assume(void* solver, int lit);
+int ipasir_solve(void* solver);
+int ipasir_val(void* solver, int lit);
+void ipasir_set_terminate(void* solver, void* data,
+                          int (*terminate)(void* data));
+}
+
+// The solver linked in through IPASIR. Its variables are DIMACS numbers,
+// one above Minisat's. It reports no search counters, so the ones for Phase
+// are what was added: clauses of two or more literals, and units.
+class IpasirBackend {
+ public:
+  IpasirBackend() : solver_(ipasir_init()) {
+    ipasir_set_terminate(solver_, &interrupted_, [](void* data) {
+      return static_cast<std::atomic<bool>*>(data)->load() ? 1 : 0;
+    });
+  }
+  ~IpasirBackend() { ipasir_release(solver_); }
+  IpasirBackend(const IpasirBackend&) = delete;
+  IpasirBackend& operator=(const IpasirBackend&) = delete;
+
+  static const char* signature() { return ipasir_signature(); }
+
+  Minisat::Var newVar() { return vars_++; }
+
+  template <typename C>
+  bool addClause(const C& c) {
+    int n = static_cast<int>(c.size());
+    for (int i = 0; i < n; ++i)
+      ipasir_add(solver_, Dimacs(c[i]));
+    ipasir_add(solver_, 0);
+    ++(n == 1 ? units_ : clauses_);
+    return true;
+  }
+
+  void assume(Minisat::Lit p) { ipasir_assume(solver_, Dimacs(p)); }
+
+  bool solve() {
+    bool solved = ipasir_solve(solver_) == 10;
+    interrupted_ = false;
+    return solved;
+  }
+
+  // Variables the solver leaves open count as false.
+  bool value(Minisat::Lit p) const {
+    return (ipasir_val(solver_, Minisat::var(p) + 1) > 0) !=
+           Minisat::sign(p);
+  }
+
+  void interrupt() { interrupted_ = true; }
+
+  BackendStats stats() const { return BackendStats(); }
+
+  int nVars() const { return vars_; }
+  int nClauses() const { return clauses_; }
+  int nAssigns() const { return units_; }
+
+ private:
+  static int Dimacs(Minisat::Lit p) {
+    int v = Minisat::var(p) + 1;
+    return Minisat::sign(p) ? -v : v;
+  }
+
+  void* solver_;
+  Minisat::Var vars_ = 0;
+  int clauses_ = 0, units_ = 0;
+  std::atomic<bool> interrupted_{false};
+};
+#endif  // NUMBER_LINK_HAVE_IPASIR
+
+#endif  // NUMBER_LINK_BACKEND_H_
@@ -0,0 +1,805 @@
+// Benchmarks the SAT encodings over a puzzle set. The set is loaded once,
+// then each puzzle is encoded and solved --runs times on a fresh Instance,
+// the runs interleaved over the set so that drift spreads evenly. Each run
+// has its own Minisat seed and a few random decisions, as the portfolio
+// workers do, so that the runs sample the search and not only the noise of
+// one replayed search. The median and 95th percentile of each measure go
+// to a table on stdout and, with --json, to JSON lines.
+//
+// Where Linux lets it, the hardware counters of perf.h are read around the
+// parse, the encoding (Instance::Build()), the solve and show() of each run,
+// and their medians go to a second table; elsewhere bench says why once and
+// times alone. The encode times cover Instance::Build() alone.
+//
+// With --baseline, the run is then compared with one saved by --json, or
+// with --results, two saved runs are compared without running. A puzzle
+// regresses if it no longer solves, if its clauses or median conflicts
+// grow past --threshold, or if its median solve time does and a one-sided
+// Mann-Whitney test over the runs of both finds it slower at --alpha. The
+// exit status is 1 if any did.
+//
+// It is built on number_link.h, and takes the same encoding options as
+// main.
+
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "number_link.h"
+#include "perf.h"
+
+namespace {
+
+struct BenchOptions {
+  int runs = 5;
+  // The Minisat seed of the first run; run r adds 7919 r.
+  double seed = 91648253;
+  double random_var_freq = 0.005;
+  std::string json;
+  std::string baseline, results;
+  // The growth past which a measure regresses, as a fraction.
+  double threshold = 0.1;
+  double alpha = 0.05;
+};
+
+enum BenchPhase { kParse, kEncode, kSolve, kShow, kPhases };
+
+const char* const kPhaseNames[] = {"parse", "encode", "solve", "show"};
+
+// One encode and solve of a puzzle.
+struct Sample {
+  bool solved = false;
+  double encode_ms = 0, solve_ms = 0;
+  int64_t vars = 0, clauses = 0, conflicts = 0;
+  // The counters of each BenchPhase, or -1 where they were not read.
+  std::array<PerfCounters::Values, kPhases> counters;
+};
+
+struct Summary {
+  double median, p95;
+};
+
+// The median and 95th percentile of |values|, by nearest rank.
+Summary Summarize(std::vector<double> values) {
+  std::sort(values.begin(), values.end());
+  auto rank = [&](double q) {
+    size_t i = static_cast<size_t>(std::ceil(q * values.size()));
+    return values[std::max<size_t>(i, 1) - 1];
+  };
+  return Summary{rank(0.5), rank(0.95)};
+}
+
+Sample Measure(const Puzzle& puzzle, const Options& options, double seed,
+               double random_var_freq, PerfCounters* perf) {
+  Sample sample;
+  sample.counters.fill(PerfCounters::Unavailable());
+  // Runs |phase| with the clock read inside the counter window, so that the
+  // ioctls opening and closing it stay out of the time.
+  auto measure = [&](BenchPhase phase, double* ms, auto f) {
+    perf->Start();
+    auto start = std::chrono::steady_clock::now();
+    f();
+    if (ms)
+      *ms = MillisecondsSince(start);
+    sample.counters[phase] = perf->Stop();
+  };
+
+  std::istringstream in(puzzle.text);
+  Board board;
+  measure(kParse, nullptr, [&]() { board = Instance::Parse(in); });
+  std::unique_ptr<Instance> instance;
+  measure(kEncode, &sample.encode_ms,
+          [&]() { instance = Instance::Build(board, options); });
+
+  auto& solver = instance->solver.solver();
+  solver.random_seed = seed;
+  solver.random_var_freq = random_var_freq;
+  sample.vars = solver.nVars();
+  sample.clauses = solver.nClauses();
+  measure(kSolve, &sample.solve_ms,
+          [&]() { sample.solved = SolveWithoutCycles(*instance); });
+  sample.conflicts = solver.conflicts;
+  if (sample.solved) {
+    std::ostringstream out;
+    measure(kShow, nullptr, [&]() { instance->show(out); });
+  }
+  return sample;
+}
+
+// The median of each counter of |phase| over |samples|, or -1 where a run
+// did not read it.
+PerfCounters::Values MedianCounters(const std::vector<Sample>& samples,
+                                    int phase) {
+  PerfCounters::Values medians = PerfCounters::Unavailable();
+  for (int c = 0; c < PerfCounters::kCounters; ++c) {
+    std::vector<double> values;
+    for (auto& sample : samples) {
+      if (sample.counters[phase][c] < 0)
+        break;
+      values.push_back(sample.counters[phase][c]);
+    }
+    if (values.size() == samples.size())
+      medians[c] = Summarize(values).median;
+  }
+  return medians;
+}
+
+// Instructions per cycle, or 0 without both.
+double Ipc(const PerfCounters::Values& values) {
+  int64_t cycles = values[PerfCounters::kCycles];
+  int64_t instructions = values[PerfCounters::kInstructions];
+  return cycles > 0 && instructions >= 0
+             ? static_cast<double>(instructions) / cycles
+             : 0;
+}
+
+// What a comparison needs of a puzzle's results, from this run or read
+// back from the JSON lines of another.
+struct PuzzleResult {
+  std::string name;
+  bool solved = false;
+  int64_t clauses = 0;
+  double conflicts = 0;
+  std::vector<double> solve_ms;
+};
+
+// A JSON value of the kinds bench writes, an object keeping its members
+// in order.
+struct JsonValue {
+  enum Type { kBool, kNumber, kString, kArray, kObject };
+  Type type = kNumber;
+  bool boolean = false;
+  double number = 0;
+  std::string string;
+  std::vector<JsonValue> elements;
+  std::vector<std::pair<std::string, JsonValue>> members;
+
+  // The member |key| of an object, or null.
+  const JsonValue* Find(const std::string& key) const {
+    for (auto& member : members) {
+      if (member.first == key)
+        return &member.second;
+    }
+    return nullptr;
+  }
+};
+
+// Parses one JSON value making up all of |text|, or says where it is not
+// JSON in |error|. Strings take the escapes JsonString() writes, numbers
+// what strtod() reads of JSON's own characters, and whitespace, which
+// bench never writes, is an error.
+class JsonParser {
+ public:
+  explicit JsonParser(const std::string& text) : text_(text) {}
+
+  bool Parse(JsonValue* value, std::string* error) {
+    at_ = 0;
+    error_ = error;
+    if (!Value(value, 0))
+      return false;
+    return at_ == text_.size() || Fail("trailing characters");
+  }
+
+ private:
+  // Deeper than bench nests its objects.
+  static const int kMaxDepth = 8;
+
+  bool Fail(const std::string& what) {
+    *error_ = what + " at column " + std::to_string(at_ + 1);
+    return false;
+  }
+
+  bool Take(char c) {
+    if (at_ < text_.size() && text_[at_] == c) {
+      ++at_;
+      return true;
+    }
+    return false;
+  }
+
+  bool Expect(char c) {
+    return Take(c) || Fail(std::string("expected '") + c + "'");
+  }
+
+  bool Word(const char* word) {
+    size_t n = std::strlen(word);
+    if (text_.compare(at_, n, word) != 0)
+      return false;
+    at_ += n;
+    return true;
+  }
+
+  bool Value(JsonValue* value, int depth) {
+    if (depth > kMaxDepth)
+      return Fail("nesting too deep");
+    if (at_ == text_.size())
+      return Fail("expected a value");
+    char c = text_[at_];
+    if (c == '{') {
+      value->type = JsonValue::kObject;
+      ++at_;
+      if (Take('}'))
+        return true;
+      do {
+        value->members.emplace_back();
+        auto& member = value->members.back();
+        if (!String(&member.first) || !Expect(':') ||
+            !Value(&member.second, depth + 1))
+          return false;
+      } while (Take(','));
+      return Expect('}');
+    }
+    if (c == '[') {
+      value->type = JsonValue::kArray;
+      ++at_;
+      if (Take(']'))
+        return true;
+      do {
+        value->elements.emplace_back();
+        if (!Value(&value->elements.back(), depth + 1))
+          return false;
+      } while (Take(','));
+      return Expect(']');
+    }
+    if (c == '"') {
+      value->type = JsonValue::kString;
+      return String(&value->string);
+    }
+    if (Word("true") || Word("false")) {
+      value->type = JsonValue::kBool;
+      value->boolean = c == 't';
+      return true;
+    }
+    value->type = JsonValue::kNumber;
+    return Number(&value->number);
+  }
+
+  bool String(std::string* value) {
+    if (!Expect('"'))
+      return false;
+    value->clear();
+    while (at_ < text_.size()) {
+      char c = text_[at_++];
+      if (c == '"')
+        return true;
+      if (static_cast<unsigned char>(c) < 0x20)
+        return Fail("control character in string");
+      if (c == '\\') {
+        if (at_ == text_.size())
+          break;
+        c = text_[at_++];
+        if (c == 'n') {
+          c = '\n';
+        } else if (c == 'u') {
+          std::string hex = text_.substr(at_, 4);
+          char* end;
+          long code = std::strtol(hex.c_str(), &end, 16);
+          if (hex.size() != 4 || end != hex.c_str() + 4 || code >= 0x20)
+            return Fail("unexpected \\u escape");
+          c = static_cast<char>(code);
+          at_ += 4;
+        } else if (c != '"' && c != '\\') {
+          return Fail("unexpected escape");
+        }
+      }
+      *value += c;
+    }
+    return Fail("unterminated string");
+  }
+
+  bool Number(double* value) {
+    size_t end = at_;
+    while (end < text_.size() &&
+           std::strchr("-+.eE0123456789", text_[end]) != nullptr)
+      ++end;
+    std::string digits = text_.substr(at_, end - at_);
+    char* parsed;
+    *value = std::strtod(digits.c_str(), &parsed);
+    if (digits.empty() || parsed != digits.c_str() + digits.size())
+      return Fail("expected a value");
+    at_ = end;
+    return true;
+  }
+
+  const std::string& text_;
+  size_t at_ = 0;
+  std::string* error_ = nullptr;
+};
+
+// Reads one puzzle line of a --json file into |result|.
+bool ReadResult(const JsonValue& line, PuzzleResult* result,
+                std::string* error) {
+  static const char* const kKeys[] = {
+      "name", "status", "runs", "variables", "clauses", "conflicts",
+      "encode_ms", "solve_ms", "counters", "encode_samples", "solve_samples"};
+  for (auto& member : line.members) {
+    if (std::find_if(std::begin(kKeys), std::end(kKeys), [&](const char* k) {
+          return member.first == k;
+        }) == std::end(kKeys)) {
+      *error = "unexpected member \"" + member.first + "\"";
+      return false;
+    }
+  }
+  auto get = [&](const JsonValue& object, const char* key,
+                 JsonValue::Type type) -> const JsonValue* {
+    auto value = object.Find(key);
+    if (!value || value->type != type) {
+      *error = std::string("missing or mistyped \"") + key + "\"";
+      return nullptr;
+    }
+    return value;
+  };
+  auto name = get(line, "name", JsonValue::kString);
+  auto status = get(line, "status", JsonValue::kString);
+  auto runs = get(line, "runs", JsonValue::kNumber);
+  auto clauses = get(line, "clauses", JsonValue::kNumber);
+  auto conflicts = get(line, "conflicts", JsonValue::kObject);
+  auto samples = get(line, "solve_samples", JsonValue::kArray);
+  if (!name || !status || !runs || !clauses || !conflicts || !samples)
+    return false;
+  auto median = get(*conflicts, "median", JsonValue::kNumber);
+  if (!median)
+    return false;
+  if (status->string != "solved" && status->string != "unsolvable") {
+    *error = "unexpected status \"" + status->string + "\"";
+    return false;
+  }
+  if (samples->elements.size() != runs->number) {
+    *error = "solve_samples does not hold runs samples";
+    return false;
+  }
+  result->name = name->string;
+  result->solved = status->string == "solved";
+  result->clauses = static_cast<int64_t>(clauses->number);
+  result->conflicts = median->number;
+  result->solve_ms.clear();
+  for (auto& sample : samples->elements) {
+    if (sample.type != JsonValue::kNumber) {
+      *error = "solve_samples holds a non-number";
+      return false;
+    }
+    result->solve_ms.push_back(sample.number);
+  }
+  return true;
+}
+
+// Reads the puzzle lines of a --json file, which ends in its summary. Any
+// line that is not what bench writes fails the load, saying why in |error|.
+bool LoadResults(const std::string& path, std::vector<PuzzleResult>* results,
+                 std::string* error) {
+  std::ifstream in(path);
+  if (!in) {
+    *error = "cannot open it";
+    return false;
+  }
+  std::string text;
+  bool summary = false;
+  for (int number = 1; std::getline(in, text); ++number) {
+    auto fail = [&](const std::string& what) {
+      *error = "line " + std::to_string(number) + ": " + what;
+      return false;
+    };
+    if (summary)
+      return fail("after the summary");
+    JsonValue line;
+    std::string why;
+    if (!JsonParser(text).Parse(&line, &why))
+      return fail(why);
+    if (line.type != JsonValue::kObject)
+      return fail("not an object");
+    if (auto marker = line.Find("summary")) {
+      if (marker->type != JsonValue::kBool || !marker->boolean)
+        return fail("unexpected \"summary\"");
+      summary = true;
+      continue;
+    }
+    PuzzleResult result;
+    if (!ReadResult(line, &result, &why))
+      return fail(why);
+    results->push_back(result);
+  }
+  if (!summary) {
+    *error = "no summary line; the run may have been cut short";
+    return false;
+  }
+  return true;
+}
+
+// The one-sided p-value of a Mann-Whitney U test that |a| tends to be
+// larger than |b|. It is exact for small samples without ties, and
+// otherwise from the normal approximation with a tie correction.
+double MannWhitneyGreater(const std::vector<double>& a,
+                          const std::vector<double>& b) {
+  int n = a.size(), m = b.size();
+  if (n == 0 || m == 0)
+    return 1;
+  double u = 0;
+  for (double x : a) {
+    for (double y : b)
+      u += x > y ? 1 : x == y ? 0.5 : 0;
+  }
+  std::vector<double> pooled(a);
+  pooled.insert(pooled.end(), b.begin(), b.end());
+  std::sort(pooled.begin(), pooled.end());
+  double ties = 0;
+  for (size_t i = 0, j; i < pooled.size(); i = j) {
+    for (j = i; j < pooled.size() && pooled[j] == pooled[i]; ++j) {
+    }
+    double t = j - i;
+    ties += t * t * t - t;
+  }
+
+  if (ties == 0 && n + m <= 40) {
+    // orderings[j][v]: the orderings of i values of |a| and j of |b| with
+    // U = v, built up by i. The largest value adds j if it is in |a|.
+    std::vector<std::vector<double>> orderings(m + 1);
+    for (int j = 0; j <= m; ++j)
+      orderings[j].assign(1, 1);
+    for (int i = 1; i <= n; ++i) {
+      orderings[0].assign(1, 1);
+      for (int j = 1; j <= m; ++j) {
+        std::vector<double> next(i * j + 1);
+        for (size_t v = 0; v < orderings[j].size(); ++v)
+          next[v + j] += orderings[j][v];
+        for (size_t v = 0; v < orderings[j - 1].size(); ++v)
+          next[v] += orderings[j - 1][v];
+        orderings[j].swap(next);
+      }
+    }
+    double tail = 0, total = 0;
+    for (size_t v = 0; v < orderings[m].size(); ++v) {
+      total += orderings[m][v];
+      if (v >= u)
+        tail += orderings[m][v];
+    }
+    return tail / total;
+  }
+
+  double mean = n * m / 2.0, total = n + m;
+  double variance = n * m / 12.0 * (total + 1 - ties / (total * (total - 1)));
+  if (variance <= 0)
+    return 1;
+  double z = (u - mean - 0.5) / std::sqrt(variance);
+  return 0.5 * std::erfc(z / std::sqrt(2.0));
+}
+
+// The growth from |before| to |after|, as a fraction of |before| or of 1
+// if that is smaller, so that counts from zero and solves well under a
+// millisecond do not regress on noise.
+double Growth(double before, double after) {
+  return (after - before) / std::max(before, 1.0);
+}
+
+// Prints the puzzles of |current| that regressed from |baseline|, and
+// returns how many did.
+int Compare(const std::vector<PuzzleResult>& baseline,
+            const std::vector<PuzzleResult>& current,
+            const BenchOptions& bench) {
+  std::map<std::string, const PuzzleResult*> before;
+  for (auto& result : baseline)
+    before[result.name] = &result;
+
+  std::cout << "\n" << std::left << std::setw(32) << "regressed puzzle"
+            << std::setw(11) << "measure" << std::right << std::setw(14)
+            << "baseline" << std::setw(14) << "current" << std::setw(10)
+            << "change" << std::setw(9) << "p" << "\n";
+  std::cout << std::fixed;
+  int compared = 0, regressed = 0, faster = 0;
+  bool powerless = false;
+  // Counts are printed whole, times to the microsecond.
+  auto flag = [&](const std::string& name, const char* measure,
+                  double old_value, double new_value, double p) {
+    std::cout << std::left << std::setw(32) << name << std::setw(11)
+              << measure << std::right << std::setprecision(p < 0 ? 0 : 3)
+              << std::setw(14) << old_value << std::setw(14) << new_value
+              << std::setprecision(1) << std::setw(9)
+              << 100 * Growth(old_value, new_value) << "%";
+    if (p < 0)
+      std::cout << std::setw(9) << "-";
+    else
+      std::cout << std::setprecision(4) << std::setw(9) << p;
+    std::cout << "\n";
+  };
+  for (auto& now : current) {
+    auto found = before.find(now.name);
+    if (found == before.end())
+      continue;
+    auto& old = *found->second;
+    before.erase(found);
+    ++compared;
+
+    bool worse = false;
+    if (old.solved && !now.solved) {
+      std::cout << std::left << std::setw(32) << now.name << std::setw(11)
+                << "status" << std::right << std::setw(14) << "solved"
+                << std::setw(14) << "unsolvable" << "\n";
+      worse = true;
+    }
+    if (Growth(old.clauses, now.clauses) > bench.threshold) {
+      flag(now.name, "clauses", old.clauses, now.clauses, -1);
+      worse = true;
+    }
+    if (Growth(old.conflicts, now.conflicts) > bench.threshold) {
+      flag(now.name, "conflicts", old.conflicts, now.conflicts, -1);
+      worse = true;
+    }
+    if (old.solve_ms.empty() || now.solve_ms.empty())
+      continue;
+    double old_ms = Summarize(old.solve_ms).median;
+    double new_ms = Summarize(now.solve_ms).median;
+    // The smallest p the test can give, when all runs of one are slower.
+    double least = 1;
+    for (size_t k = 1; k <= now.solve_ms.size(); ++k)
+      least *= static_cast<double>(k) / (old.solve_ms.size() + k);
+    powerless |= least >= bench.alpha;
+    if (Growth(old_ms, new_ms) > bench.threshold) {
+      double p = MannWhitneyGreater(now.solve_ms, old.solve_ms);
+      if (p < bench.alpha) {
+        flag(now.name, "solve ms", old_ms, new_ms, p);
+        worse = true;
+      }
+    } else if (Growth(new_ms, old_ms) > bench.threshold &&
+               MannWhitneyGreater(old.solve_ms, now.solve_ms) < bench.alpha) {
+      ++faster;
+    }
+    regressed += worse;
+  }
+
+  std::cout << std::defaultfloat << regressed << " of " << compared
+            << " puzzles regressed past " << 100 * bench.threshold
+            << "%, " << faster << " solve significantly faster";
+  if (size_t missing = before.size())
+    std::cout << ", " << missing << " of the baseline missing";
+  if (size_t added = current.size() - compared)
+    std::cout << ", " << added << " not in it";
+  std::cout << "\n";
+  if (powerless) {
+    std::cout << "too few runs for solve times to reach p < " << bench.alpha
+              << " on some puzzles; raise --runs on both\n";
+  }
+  return regressed;
+}
+
+void BenchUsage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " --batch=PATH... [options]\n"
+            << "       " << argv0
+            << " --results=PATH --baseline=PATH [options]\n"
+            << "  --runs=N                       "
+            << "solve each puzzle N times (default 5)\n"
+            << "  --seed=S                       "
+            << "Minisat random seed of the first run, S + 7919 r of run r\n"
+            << "  --random-var-freq=F            "
+            << "share of random decisions (default 0.005; at 0 the\n"
+            << "                                 "
+            << "seed goes unused and runs replay one search)\n"
+            << "  --json=PATH                    "
+            << "also write a JSON line per puzzle and a summary\n"
+            << "  --baseline=PATH                "
+            << "compare with the --json of an earlier run\n"
+            << "  --results=PATH                 "
+            << "compare that --json instead of running\n"
+            << "  --threshold=PCT                "
+            << "growth that regresses (default 10)\n"
+            << "  --alpha=A                      "
+            << "significance of slower solves (default 0.05)\n"
+            << "and the encoding options of main:\n";
+  Usage(argv0);
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  BenchOptions bench;
+  std::vector<char*> rest(1, argv[0]);
+  std::string args;
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    args += (i > 1 ? " " : "") + arg;
+    if (arg.compare(0, 7, "--runs=") == 0)
+      bench.runs = std::atoi(arg.c_str() + 7);
+    else if (arg.compare(0, 7, "--seed=") == 0)
+      bench.seed = std::atof(arg.c_str() + 7);
+    else if (arg.compare(0, 18, "--random-var-freq=") == 0)
+      bench.random_var_freq = std::atof(arg.c_str() + 18);
+    else if (arg.compare(0, 7, "--json=") == 0)
+      bench.json = arg.substr(7);
+    else if (arg.compare(0, 11, "--baseline=") == 0)
+      bench.baseline = arg.substr(11);
+    else if (arg.compare(0, 10, "--results=") == 0)
+      bench.results = arg.substr(10);
+    else if (arg.compare(0, 12, "--threshold=") == 0)
+      bench.threshold = std::atof(arg.c_str() + 12) / 100;
+    else if (arg.compare(0, 8, "--alpha=") == 0)
+      bench.alpha = std::atof(arg.c_str() + 8);
+    else
+      rest.push_back(argv[i]);
+  }
+
+  std::vector<PuzzleResult> baseline;
+  std::string error;
+  if (!bench.baseline.empty() &&
+      !LoadResults(bench.baseline, &baseline, &error)) {
+    std::cerr << "Failed to load " << bench.baseline << ": " << error << "\n";
+    return -1;
+  }
+  if (!bench.results.empty()) {
+    std::vector<PuzzleResult> results;
+    if (bench.baseline.empty() || rest.size() > 1) {
+      BenchUsage(argv[0]);
+      return -1;
+    }
+    if (!LoadResults(bench.results, &results, &error)) {
+      std::cerr << "Failed to load " << bench.results << ": " << error
+                << "\n";
+      return -1;
+    }
+    return Compare(baseline, results, bench) ? 1 : 0;
+  }
+
+  Options options;
+  if (!ParseOptions(rest.size(), rest.data(), &options) ||
+      options.batch.empty() || bench.runs < 1) {
+    BenchUsage(argv[0]);
+    return -1;
+  }
+  if ((options.engine != Engine::Labels && options.engine != Engine::Edges) ||
+      options.backend != Backend::Minisat || options.portfolio > 0 ||
+      options.cubes > 0 || options.enumerate != Options::None) {
+    std::cerr << "bench measures single solves on Minisat with "
+              << "--engine=labels or edges\n";
+    return -1;
+  }
+
+  std::vector<Puzzle> puzzles;
+  for (auto& path : options.batch) {
+    if (!LoadPuzzles(path, &puzzles)) {
+      std::cerr << "Failed to load " << path << "\n";
+      return -1;
+    }
+  }
+  std::vector<Puzzle> rectangular;
+  for (auto& puzzle : puzzles) {
+    if (IsRectangular(puzzle.text))
+      rectangular.push_back(puzzle);
+    else
+      std::cerr << "skipping " << puzzle.name << ": ragged rows\n";
+  }
+  puzzles.swap(rectangular);
+
+  PerfCounters perf;
+  if (!perf.available()) {
+    std::cerr << "hardware counters unavailable (" << perf.error()
+              << "), timing only\n";
+  }
+  std::vector<std::vector<Sample>> samples(puzzles.size());
+  for (int r = 0; r < bench.runs; ++r) {
+    for (size_t i = 0; i < puzzles.size(); ++i) {
+      samples[i].push_back(Measure(puzzles[i], options,
+                                   bench.seed + 7919 * r,
+                                   bench.random_var_freq, &perf));
+    }
+  }
+
+  std::ofstream json;
+  bool write_json = !bench.json.empty();
+  if (write_json) {
+    json.open(bench.json);
+    if (!json) {
+      std::cerr << "Failed to open " << bench.json << "\n";
+      return -1;
+    }
+    json.precision(12);
+  }
+
+  std::cout << std::left << std::setw(32) << "puzzle" << std::right
+            << std::setw(9) << "vars" << std::setw(10) << "clauses"
+            << std::setw(10) << "conflicts"
+            << "  encode ms med/p95    solve ms med/p95\n";
+  std::cout << std::fixed << std::setprecision(3);
+  int solved = 0;
+  double encode_total = 0, solve_total = 0;
+  std::vector<PuzzleResult> results;
+  for (size_t i = 0; i < puzzles.size(); ++i) {
+    std::vector<double> encode, solve, conflicts;
+    for (auto& sample : samples[i]) {
+      encode.push_back(sample.encode_ms);
+      solve.push_back(sample.solve_ms);
+      conflicts.push_back(sample.conflicts);
+    }
+    auto& first = samples[i].front();
+    Summary e = Summarize(encode), s = Summarize(solve);
+    Summary c = Summarize(conflicts);
+    solved += first.solved;
+    encode_total += e.median;
+    solve_total += s.median;
+    results.emplace_back();
+    results.back().name = puzzles[i].name;
+    results.back().solved = first.solved;
+    results.back().clauses = first.clauses;
+    results.back().conflicts = c.median;
+    results.back().solve_ms = solve;
+
+    std::cout << std::left << std::setw(32) << puzzles[i].name << std::right
+              << std::setw(9) << first.vars << std::setw(10) << first.clauses
+              << std::setw(10) << static_cast<int64_t>(c.median)
+              << std::setw(10) << e.median << std::setw(9) << e.p95
+              << std::setw(12) << s.median << std::setw(9) << s.p95
+              << (first.solved ? "" : "  unsolved") << "\n";
+    if (write_json) {
+      json << "{\"name\":" << JsonString(puzzles[i].name)
+           << ",\"status\":\"" << (first.solved ? "solved" : "unsolvable")
+           << "\",\"runs\":" << bench.runs
+           << ",\"variables\":" << first.vars
+           << ",\"clauses\":" << first.clauses
+           << ",\"conflicts\":{\"median\":" << c.median
+           << ",\"p95\":" << c.p95 << "}"
+           << ",\"encode_ms\":{\"median\":" << e.median
+           << ",\"p95\":" << e.p95 << "}"
+           << ",\"solve_ms\":{\"median\":" << s.median
+           << ",\"p95\":" << s.p95 << "}";
+      if (perf.available()) {
+        json << ",\"counters\":{";
+        for (int phase = 0; phase < kPhases; ++phase) {
+          auto medians = MedianCounters(samples[i], phase);
+          json << (phase ? "," : "") << "\"" << kPhaseNames[phase]
+               << "\":{";
+          for (int c = 0; c < PerfCounters::kCounters; ++c) {
+            json << "\"" << PerfCounters::Name(c) << "\":" << medians[c]
+                 << ",";
+          }
+          json << "\"ipc\":" << Ipc(medians) << "}";
+        }
+        json << "}";
+      }
+      json << ",\"encode_samples\":[";
+      for (size_t r = 0; r < encode.size(); ++r)
+        json << (r ? "," : "") << encode[r];
+      json << "],\"solve_samples\":[";
+      for (size_t r = 0; r < solve.size(); ++r)
+        json << (r ? "," : "") << solve[r];
+      json << "]}\n";
+    }
+  }
+  std::cout << "total: " << puzzles.size() << " puzzles, " << solved
+            << " solved, medians sum to " << encode_total
+            << " ms encoding and " << solve_total << " ms solving\n";
+
+  if (perf.available()) {
+    std::cout << "\n" << std::left << std::setw(32) << "puzzle"
+              << std::setw(8) << "phase" << std::right;
+    for (int c = 0; c < PerfCounters::kCounters; ++c)
+      std::cout << std::setw(15) << PerfCounters::Name(c);
+    std::cout << std::setw(7) << "ipc" << "\n" << std::setprecision(2);
+    for (size_t i = 0; i < puzzles.size(); ++i) {
+      for (int phase = 0; phase < kPhases; ++phase) {
+        auto medians = MedianCounters(samples[i], phase);
+        std::cout << std::left << std::setw(32) << puzzles[i].name
+                  << std::setw(8) << kPhaseNames[phase] << std::right;
+        for (int c = 0; c < PerfCounters::kCounters; ++c) {
+          std::cout << std::setw(15);
+          if (medians[c] < 0)
+            std::cout << "-";
+          else
+            std::cout << medians[c];
+        }
+        std::cout << std::setw(7) << Ipc(medians) << "\n";
+      }
+    }
+  }
+  if (write_json) {
+    json << "{\"summary\":true,\"args\":" << JsonString(args)
+         << ",\"runs\":" << bench.runs << ",\"seed\":" << bench.seed
+         << ",\"random_var_freq\":" << bench.random_var_freq
+         << ",\"puzzles\":" << puzzles.size() << ",\"solved\":" << solved
+         << ",\"encode_ms\":" << encode_total
+         << ",\"solve_ms\":" << solve_total
+         << ",\"counters\":" << (perf.available() ? "true" : "false")
+         << "}\n";
+  }
+  if (!bench.baseline.empty())
+    return Compare(baseline, results, bench) ? 1 : 0;
+  return 0;
+}
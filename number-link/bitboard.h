@@ -0,0 +1,421 @@
+#ifndef NUMBER_LINK_BITBOARD_H_
+#define NUMBER_LINK_BITBOARD_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define NUMBER_LINK_HAVE_AVX2 1
+#endif
+
+// A backtracking solver on bitboards, for boards up to 64 columns.
+//
+// Every board is a column of uint64_t rows with bit j for column j and an
+// empty row of padding above and below: the free cells, the cells of each
+// label, and the edges of the paths, east and south of their cell, that
+// Record() reads the solution from. Paths grow one cell at a time from
+// their first endpoint, always extending the label with the fewest moves.
+// After each move a state is dropped if
+//  - some free cell has fewer than two free or path-end neighbours,
+//  - some region of free cells is not reachable by both ends of any one
+//    label, which would leave it uncovered, or
+//  - some label has no region that touches both its ends, nor can step
+//    straight into its target,
+// the regions being found by flood fills, with AVX2 where the CPU has it.
+// Failed states are remembered in a Zobrist-hashed transposition table.
+// Feasible() runs between moves and never nests, so its boards are scratch
+// owned by the solver rather than allocated at each node.
+//
+// With |unique|, a path may not touch itself: cells of one label that are
+// adjacent must be linked, as the Stick constraint has it.
+class BitboardSolver {
+ public:
+  static const int kMaxWidth = 64;
+
+  struct Stats {
+    int64_t nodes = 0;
+    int64_t table_hits = 0;
+    bool avx2 = false;
+  };
+
+  // |givens| holds the label index of each endpoint cell and -1 elsewhere.
+  // Labels must appear exactly twice.
+  BitboardSolver(int width, int height, int pairs,
+                 const std::vector<int>& givens, bool unique)
+      : width_(width), height_(height), pairs_(pairs), unique_(unique),
+        rows_(height + 2), full_(width == 64 ? ~0ull : (1ull << width) - 1),
+        free_(rows_), label_cells_(pairs, Board(rows_)), east_(rows_),
+        south_(rows_), head_(pairs, -1), target_(pairs, -1), done_(pairs),
+        paths_(pairs), ends_(rows_), left_(rows_), region_(rows_),
+        touch_(rows_), joined_(pairs), cell_keys_(pairs * width * height),
+        head_keys_(pairs * width * height), table_(kTableSize) {
+    uint64_t seed = 0x9e3779b97f4a7c15ull;
+    for (auto* keys : {&cell_keys_, &head_keys_}) {
+      for (auto& key : *keys)
+        key = SplitMix(&seed);
+    }
+    hash_ = SplitMix(&seed);
+
+    for (int i = 0; i < height; ++i)
+      free_[i + 1] = full_;
+    for (int c = 0; c < width * height; ++c) {
+      int k = givens[c];
+      if (k < 0)
+        continue;
+      Clear(&free_, c);
+      Set(&label_cells_[k], c);
+      if (head_[k] < 0) {
+        head_[k] = c;
+        paths_[k].push_back(c);
+        hash_ ^= head_keys_[k * width_ * height_ + c];
+      } else {
+        valid_ = valid_ && target_[k] < 0;
+        target_[k] = c;
+      }
+    }
+    for (int k = 0; k < pairs; ++k)
+      valid_ = valid_ && head_[k] >= 0 && target_[k] >= 0;
+
+#ifdef NUMBER_LINK_HAVE_AVX2
+    stats_.avx2 = __builtin_cpu_supports("avx2");
+#endif
+  }
+
+  bool Solve() {
+    return valid_ && width_ <= kMaxWidth && Search();
+  }
+
+  // Whether the edge at position |p| of Instance::east_west or north_south
+  // is on in the solution.
+  bool east_west(int p) const { return east_west_[p]; }
+  bool north_south(int p) const { return north_south_[p]; }
+
+  const Stats& stats() const { return stats_; }
+
+ private:
+  typedef std::vector<uint64_t> Board;
+  static const uint64_t kTableSize = 1 << 16;
+
+  static uint64_t SplitMix(uint64_t* state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+  }
+
+  bool Test(const Board& b, int c) const {
+    return (b[c / width_ + 1] >> (c % width_)) & 1;
+  }
+  void Set(Board* b, int c) { (*b)[c / width_ + 1] |= 1ull << (c % width_); }
+  void Clear(Board* b, int c) {
+    (*b)[c / width_ + 1] &= ~(1ull << (c % width_));
+  }
+
+  // The cells next to |c|, and how many there are.
+  int Neighbours(int c, int out[4]) const {
+    int i = c / width_, j = c % width_, n = 0;
+    if (i > 0) out[n++] = c - width_;
+    if (i + 1 < height_) out[n++] = c + width_;
+    if (j + 1 < width_) out[n++] = c + 1;
+    if (j > 0) out[n++] = c - 1;
+    return n;
+  }
+
+  // Turns the edge between neighbours |c| and |d| on or off.
+  void Link(int c, int d, bool on) {
+    int at = std::min(c, d);
+    Board* edges = width_ > 1 && std::max(c, d) == at + 1 ? &east_ : &south_;
+    if (on)
+      Set(edges, at);
+    else
+      Clear(edges, at);
+  }
+
+  // Row |i| of the cells next to those of |b|.
+  uint64_t Spread(const Board& b, int i) const {
+    return ((b[i] << 1) | (b[i] >> 1) | b[i - 1] | b[i + 1]) & full_;
+  }
+
+  // Grows |seed| to the cells of |mask| connected to it.
+  void Flood(const Board& mask, Board* seed) {
+#ifdef NUMBER_LINK_HAVE_AVX2
+    if (stats_.avx2) {
+      FloodAvx2(mask.data(), seed->data(), height_);
+      return;
+    }
+#endif
+    FloodScalar(mask, seed);
+  }
+
+  // Alternates downward and upward sweeps, each filling rows completely
+  // before moving on.
+  void FloodScalar(const Board& mask, Board* seed) {
+    auto& s = *seed;
+    for (bool changed = true; changed;) {
+      changed = false;
+      auto sweep = [&](int i) {
+        uint64_t r = (s[i] | s[i - 1] | s[i + 1]) & mask[i];
+        if (!r)
+          return;
+        for (uint64_t x; (x = (r | (r << 1) | (r >> 1)) & mask[i]) != r;)
+          r = x;
+        if (r != s[i]) {
+          s[i] = r;
+          changed = true;
+        }
+      };
+      for (int i = 1; i <= height_; ++i)
+        sweep(i);
+      for (int i = height_; i >= 1; --i)
+        sweep(i);
+    }
+  }
+
+#ifdef NUMBER_LINK_HAVE_AVX2
+  // Steps blocks of four rows at once, and the rows left over one by one,
+  // until nothing changes. The padding rows stand in for the neighbours of
+  // the first and last rows.
+  __attribute__((target("avx2")))
+  static void FloodAvx2(const uint64_t* mask, uint64_t* seed, int height) {
+    for (bool changed = true; changed;) {
+      changed = false;
+      for (int i = 1; i <= height; i += 4) {
+        if (i + 4 > height + 1) {
+          for (int r = i; r <= height; ++r) {
+            uint64_t s = seed[r];
+            uint64_t x = (s | (s << 1) | (s >> 1) | seed[r - 1] |
+                          seed[r + 1]) & mask[r];
+            if (x != s) {
+              seed[r] = x;
+              changed = true;
+            }
+          }
+          break;
+        }
+        __m256i s = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(seed + i));
+        __m256i up = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(seed + i - 1));
+        __m256i down = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(seed + i + 1));
+        __m256i m = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(mask + i));
+        __m256i x = _mm256_or_si256(
+            _mm256_or_si256(s, _mm256_slli_epi64(s, 1)),
+            _mm256_or_si256(_mm256_srli_epi64(s, 1),
+                            _mm256_or_si256(up, down)));
+        x = _mm256_and_si256(x, m);
+        if (!_mm256_testc_si256(s, x)) {
+          _mm256_storeu_si256(reinterpret_cast<__m256i*>(seed + i), x);
+          changed = true;
+        }
+      }
+    }
+  }
+#endif
+
+  // Whether every free cell can still be covered and every open label
+  // still joined.
+  bool Feasible() {
+    // Path ends that free cells may connect to.
+    auto& ends = ends_;
+    std::fill(ends.begin(), ends.end(), 0);
+    for (int k = 0; k < pairs_; ++k) {
+      if (!done_[k]) {
+        Set(&ends, head_[k]);
+        Set(&ends, target_[k]);
+      }
+    }
+
+    // Free cells need two ways in or out: at least two of the four shifted
+    // boards have their bit.
+    for (int i = 1; i <= height_; ++i) {
+      uint64_t open_up = free_[i - 1] | ends[i - 1];
+      uint64_t open_down = free_[i + 1] | ends[i + 1];
+      uint64_t row = free_[i] | ends[i];
+      uint64_t a = open_up, b = open_down;
+      uint64_t c = (row << 1) & full_, d = row >> 1;
+      uint64_t two = (a & b) | (a & c) | (a & d) | (b & c) | (b & d) | (c & d);
+      if (free_[i] & ~two)
+        return false;
+    }
+
+    // Regions of free cells, and the labels whose ends both touch them.
+    auto& joined = joined_;
+    auto &left = left_, &region = region_, &touch = touch_;
+    std::fill(joined.begin(), joined.end(), 0);
+    left = free_;
+    for (int i = 1; i <= height_; ++i) {
+      while (left[i]) {
+        std::fill(region.begin(), region.end(), 0);
+        region[i] = left[i] & -left[i];
+        Flood(free_, &region);
+        for (int r = 1; r <= height_; ++r) {
+          left[r] &= ~region[r];
+          touch[r] = Spread(region, r) | region[r];
+        }
+        bool served = false;
+        for (int k = 0; k < pairs_; ++k) {
+          if (!done_[k] && Test(touch, head_[k]) &&
+              Test(touch, target_[k])) {
+            joined[k] = served = true;
+          }
+        }
+        if (!served)
+          return false;
+      }
+    }
+
+    for (int k = 0; k < pairs_; ++k) {
+      if (done_[k] || joined[k])
+        continue;
+      int n[4];
+      int count = Neighbours(head_[k], n);
+      if (std::find(n, n + count, target_[k]) == n + count)
+        return false;
+    }
+    return true;
+  }
+
+  // The cells label |k| may step into next.
+  int Moves(int k, int out[4]) const {
+    int n[4];
+    int count = Neighbours(head_[k], n), moves = 0;
+    for (int t = 0; t < count; ++t) {
+      if (n[t] == target_[k]) {
+        if (unique_) {
+          out[0] = n[t];
+          return 1;
+        }
+        out[moves++] = n[t];
+      }
+    }
+    for (int t = 0; t < count; ++t) {
+      if (!Test(free_, n[t]))
+        continue;
+      if (unique_) {
+        // The new cell may touch no cell of its path but the head and the
+        // target, which it must then step into.
+        int m[4];
+        int around = Neighbours(n[t], m);
+        bool touches = false;
+        for (int u = 0; u < around; ++u) {
+          touches |= m[u] != head_[k] && m[u] != target_[k] &&
+                     Test(label_cells_[k], m[u]);
+        }
+        if (touches)
+          continue;
+      }
+      out[moves++] = n[t];
+    }
+    return moves;
+  }
+
+  void Move(int k, int c) {
+    int cells = width_ * height_;
+    hash_ ^= head_keys_[k * cells + head_[k]] ^ head_keys_[k * cells + c];
+    Link(head_[k], c, true);
+    head_[k] = c;
+    paths_[k].push_back(c);
+    if (c == target_[k]) {
+      done_[k] = true;
+      return;
+    }
+    hash_ ^= cell_keys_[k * cells + c];
+    Clear(&free_, c);
+    Set(&label_cells_[k], c);
+  }
+
+  void Undo(int k) {
+    int cells = width_ * height_;
+    int c = paths_[k].back();
+    paths_[k].pop_back();
+    int previous = paths_[k].back();
+    hash_ ^= head_keys_[k * cells + c] ^ head_keys_[k * cells + previous];
+    Link(previous, c, false);
+    head_[k] = previous;
+    if (c == target_[k]) {
+      done_[k] = false;
+      return;
+    }
+    hash_ ^= cell_keys_[k * cells + c];
+    Set(&free_, c);
+    Clear(&label_cells_[k], c);
+  }
+
+  bool Search() {
+    ++stats_.nodes;
+    int best = -1, best_count = 5, moves[4];
+    for (int k = 0; k < pairs_; ++k) {
+      if (done_[k])
+        continue;
+      int count = Moves(k, moves);
+      if (count < best_count) {
+        best = k;
+        best_count = count;
+      }
+    }
+    if (best < 0) {
+      for (int i = 1; i <= height_; ++i) {
+        if (free_[i])
+          return false;
+      }
+      Record();
+      return true;
+    }
+
+    // Keys are stored with their low bit set, which the index already
+    // holds, so that no state matches an empty slot.
+    uint64_t key = hash_ | 1;
+    auto& slot = table_[hash_ & (kTableSize - 1)];
+    if (slot == key) {
+      ++stats_.table_hits;
+      return false;
+    }
+    if (best_count && Feasible()) {
+      Moves(best, moves);
+      for (int t = 0; t < best_count; ++t) {
+        Move(best, moves[t]);
+        if (Search())
+          return true;
+        Undo(best);
+      }
+    }
+    table_[hash_ & (kTableSize - 1)] = key;
+    return false;
+  }
+
+  // Writes the edge boards out in Instance's layout.
+  void Record() {
+    east_west_.assign((width_ + 1) * height_, false);
+    north_south_.assign(width_ * (height_ + 1), false);
+    for (int c = 0; c < width_ * height_; ++c) {
+      int i = c / width_, j = c % width_;
+      east_west_[i * (width_ + 1) + j + 1] = Test(east_, c);
+      north_south_[(i + 1) * width_ + j] = Test(south_, c);
+    }
+  }
+
+  int width_, height_, pairs_;
+  bool unique_;
+  bool valid_ = true;
+  int rows_;
+  uint64_t full_;
+  Board free_;
+  std::vector<Board> label_cells_;
+  Board east_, south_;
+  std::vector<int> head_, target_;
+  std::vector<char> done_;
+  std::vector<std::vector<int>> paths_;
+  // Scratch of Feasible().
+  Board ends_, left_, region_, touch_;
+  std::vector<char> joined_;
+  std::vector<uint64_t> cell_keys_, head_keys_, table_;
+  uint64_t hash_;
+  std::vector<char> east_west_, north_south_;
+  Stats stats_;
+};
+
+#endif  // NUMBER_LINK_BITBOARD_H_
@@ -0,0 +1,451 @@
+#ifndef NUMBER_LINK_CARDINALITY_H_
+#define NUMBER_LINK_CARDINALITY_H_
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iterator>
+#include <map>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "minisat/core/Solver.h"
+
+// Encodings of "exactly n of these literals are true".
+//
+// Every encoder is a template over the clause sink, so that the same code can
+// feed a Minisat::Solver or a ClauseCounter that only measures the encoding.
+// A sink needs newVar() and addClause() with 1 to 3 literals or a vec<Lit>.
+
+enum class Cardinality {
+  Auto = 0, Binomial, Sequential, Totalizer, Commander, Product
+};
+
+const int kCardinalityCount = 6;
+
+inline const char* CardinalityName(Cardinality c) {
+  switch (c) {
+    case Cardinality::Auto: return "auto";
+    case Cardinality::Binomial: return "binomial";
+    case Cardinality::Sequential: return "sequential";
+    case Cardinality::Totalizer: return "totalizer";
+    case Cardinality::Commander: return "commander";
+    case Cardinality::Product: return "product";
+  }
+  return "?";
+}
+
+inline bool ParseCardinality(const std::string& name, Cardinality* c) {
+  for (int i = 0; i < kCardinalityCount; ++i) {
+    if (name == CardinalityName(static_cast<Cardinality>(i))) {
+      *c = static_cast<Cardinality>(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Counts the variables and clauses an encoding produces, without solving.
+struct ClauseCounter {
+  int vars = 0;
+  int64_t clauses = 0;
+
+  Minisat::Var newVar() { return vars++; }
+  bool addClause(const Minisat::vec<Minisat::Lit>&) { ++clauses; return true; }
+  bool addClause(Minisat::Lit) { ++clauses; return true; }
+  bool addClause(Minisat::Lit, Minisat::Lit) { ++clauses; return true; }
+  bool addClause(Minisat::Lit, Minisat::Lit, Minisat::Lit) {
+    ++clauses;
+    return true;
+  }
+};
+
+// Forwards to |solver| and counts what passes through.
+template <typename Solver>
+struct CountingSink {
+  Solver& solver;
+  int vars = 0;
+  int64_t clauses = 0;
+
+  explicit CountingSink(Solver& solver) : solver(solver) {}
+
+  Minisat::Var newVar() {
+    ++vars;
+    return solver.newVar();
+  }
+
+  template <typename... Args>
+  bool addClause(const Args&... args) {
+    ++clauses;
+    return solver.addClause(args...);
+  }
+};
+
+// Stores |k| items from |itr| to |end| into |c|, and call |f|.
+template <typename Iterator, typename Container, typename F>
+void Choose(int k,
+            Iterator itr, Iterator end,
+            Container& c,
+            F f) {
+  int n = std::distance(itr, end);
+  if (k > n)
+    return;
+
+  if (k == 0) {
+    f();
+    return;
+  }
+
+  if (k == n) {
+    c.insert(c.end(), itr, end);
+    f();
+    c.erase(c.end() - n, c.end());
+    return;
+  }
+
+  c.push_back(*itr);
+  ++itr;
+  Choose(k - 1, itr, end, c, f);
+  c.pop_back();
+
+  Choose(k, itr, end, c, f);
+}
+
+template <typename Solver, typename Iterator>
+void LessThan(Solver& solver, int n, Iterator itr, Iterator end) {
+  std::vector<Minisat::Lit> vs;
+  Choose(n, itr, end, vs, [&]() {
+    Minisat::vec<Minisat::Lit> clause;
+    clause.capacity(vs.size());
+    for (auto& v : vs)
+      clause.push(~v);
+    solver.addClause(clause);
+  });
+}
+
+template <typename Solver, typename Iterator>
+void GreaterThan(Solver& solver, int n, Iterator itr, Iterator end) {
+  std::vector<Minisat::Lit> vs;
+  Choose(std::distance(itr, end) - n, itr, end, vs, [&]() {
+    Minisat::vec<Minisat::Lit> clause;
+    clause.capacity(vs.size());
+    for (auto& v : vs)
+      clause.push(v);
+    solver.addClause(clause);
+  });
+}
+
+template <typename Solver, typename Iterator>
+void Exact(Solver& solver, int n, Iterator itr, Iterator end) {
+  LessThan(solver, n + 1, itr, end);
+  GreaterThan(solver, n - 1, itr, end);
+}
+
+template <typename Solver, typename T>
+void Exact(Solver& solver, int n, const T& xs) {
+  using std::begin;
+  using std::end;
+  Exact(solver, n, begin(xs), end(xs));
+}
+
+inline double BinomialCoefficient(int n, int k) {
+  if (k < 0 || k > n)
+    return 0;
+  double r = 1;
+  for (int i = 1; i <= k; ++i)
+    r = r * (n - k + i) / i;
+  return r;
+}
+
+// Picks a concrete encoding of Exact(k) over |n| literals. The binomial
+// encoding propagates best and needs no auxiliary variables, so it is kept
+// while it stays within a few clauses per literal.
+inline Cardinality ResolveCardinality(Cardinality c, int n, int k) {
+  if (k <= 0 || k >= n)
+    return Cardinality::Binomial;
+  if (c == Cardinality::Auto) {
+    double binomial = BinomialCoefficient(n, k + 1) +
+                      BinomialCoefficient(n, n - k + 1);
+    if (binomial <= 4 * n)
+      return Cardinality::Binomial;
+    return k == 1 || k == n - 1 ? Cardinality::Sequential
+                                : Cardinality::Totalizer;
+  }
+  if ((c == Cardinality::Commander || c == Cardinality::Product) &&
+      k != 1 && k != n - 1)
+    return Cardinality::Sequential;
+  return c;
+}
+
+// AtMost(k) by Sinz's sequential counter: s[i][j] <=> "at least j + 1 of
+// xs[0..i] are true".
+template <typename Solver>
+void SequentialAtMost(Solver& solver, int k,
+                      const std::vector<Minisat::Lit>& xs) {
+  int n = xs.size();
+  std::vector<Minisat::Lit> prev(k), cur(k);
+  for (int j = 0; j < k; ++j)
+    prev[j] = Minisat::mkLit(solver.newVar());
+  solver.addClause(~xs[0], prev[0]);
+  for (int j = 1; j < k; ++j)
+    solver.addClause(~prev[j]);
+
+  for (int i = 1; i < n - 1; ++i) {
+    for (int j = 0; j < k; ++j)
+      cur[j] = Minisat::mkLit(solver.newVar());
+    solver.addClause(~xs[i], cur[0]);
+    solver.addClause(~prev[0], cur[0]);
+    for (int j = 1; j < k; ++j) {
+      solver.addClause(~xs[i], ~prev[j - 1], cur[j]);
+      solver.addClause(~prev[j], cur[j]);
+    }
+    solver.addClause(~xs[i], ~prev[k - 1]);
+    std::swap(prev, cur);
+  }
+  solver.addClause(~xs[n - 1], ~prev[k - 1]);
+}
+
+// AtMost(1) by grouping into threes under commander variables:
+// x => c for each x in the group, and recursively AtMost(1) of commanders.
+template <typename Solver>
+void CommanderAtMostOne(Solver& solver, const std::vector<Minisat::Lit>& xs) {
+  if (xs.size() <= 4) {
+    LessThan(solver, 2, xs.begin(), xs.end());
+    return;
+  }
+
+  std::vector<Minisat::Lit> commanders;
+  for (size_t i = 0; i < xs.size(); i += 3) {
+    auto group_end = xs.begin() + std::min(i + 3, xs.size());
+    LessThan(solver, 2, xs.begin() + i, group_end);
+    auto c = Minisat::mkLit(solver.newVar());
+    for (auto x = xs.begin() + i; x != group_end; ++x)
+      solver.addClause(~*x, c);
+    commanders.push_back(c);
+  }
+  CommanderAtMostOne(solver, commanders);
+}
+
+// AtMost(1) by Chen's product encoding: place xs on a p * q grid, and
+// require at most one row and at most one column to be used.
+template <typename Solver>
+void ProductAtMostOne(Solver& solver, const std::vector<Minisat::Lit>& xs) {
+  int n = xs.size();
+  if (n <= 4) {
+    LessThan(solver, 2, xs.begin(), xs.end());
+    return;
+  }
+
+  int p = std::ceil(std::sqrt(n));
+  int q = (n + p - 1) / p;
+  std::vector<Minisat::Lit> rows, columns;
+  for (int r = 0; r < p; ++r)
+    rows.push_back(Minisat::mkLit(solver.newVar()));
+  for (int c = 0; c < q; ++c)
+    columns.push_back(Minisat::mkLit(solver.newVar()));
+  for (int i = 0; i < n; ++i) {
+    solver.addClause(~xs[i], rows[i / q]);
+    solver.addClause(~xs[i], columns[i % q]);
+  }
+  ProductAtMostOne(solver, rows);
+  ProductAtMostOne(solver, columns);
+}
+
+template <typename Solver>
+void AtMost(Solver& solver, int k, const std::vector<Minisat::Lit>& xs,
+            Cardinality c) {
+  int n = xs.size();
+  if (k >= n)
+    return;
+  if (k == 0) {
+    for (auto& x : xs)
+      solver.addClause(~x);
+    return;
+  }
+  if (k == n - 1) {
+    Minisat::vec<Minisat::Lit> clause;
+    for (auto& x : xs)
+      clause.push(~x);
+    solver.addClause(clause);
+    return;
+  }
+
+  switch (c) {
+    case Cardinality::Commander:
+      if (k == 1) {
+        CommanderAtMostOne(solver, xs);
+        return;
+      }
+      break;
+    case Cardinality::Product:
+      if (k == 1) {
+        ProductAtMostOne(solver, xs);
+        return;
+      }
+      break;
+    case Cardinality::Binomial:
+      LessThan(solver, k + 1, xs.begin(), xs.end());
+      return;
+    default:
+      break;
+  }
+  SequentialAtMost(solver, k, xs);
+}
+
+// Builds a unary counter over xs[lo..hi) by Bailleux and Boufkhad's
+// totalizer, truncated at |cap| outputs: out[j] <=> "at least j + 1 true",
+// where out.back() also covers any larger count.
+template <typename Solver>
+std::vector<Minisat::Lit> Totalize(Solver& solver,
+                                   const std::vector<Minisat::Lit>& xs,
+                                   size_t lo, size_t hi, int cap) {
+  if (hi - lo == 1)
+    return std::vector<Minisat::Lit>(1, xs[lo]);
+
+  size_t mid = (lo + hi) / 2;
+  auto a = Totalize(solver, xs, lo, mid, cap);
+  auto b = Totalize(solver, xs, mid, hi, cap);
+  int p = a.size(), q = b.size();
+  int m = std::min(p + q, cap);
+  std::vector<Minisat::Lit> out;
+  for (int j = 0; j < m; ++j)
+    out.push_back(Minisat::mkLit(solver.newVar()));
+
+  Minisat::vec<Minisat::Lit> clause;
+  for (int alpha = 0; alpha <= p; ++alpha) {
+    for (int beta = 0; beta <= q && alpha + beta <= m; ++beta) {
+      int sigma = alpha + beta;
+      // a[alpha - 1] & b[beta - 1] => out[sigma - 1]
+      if (sigma > 0) {
+        clause.clear();
+        if (alpha > 0)
+          clause.push(~a[alpha - 1]);
+        if (beta > 0)
+          clause.push(~b[beta - 1]);
+        clause.push(out[sigma - 1]);
+        solver.addClause(clause);
+      }
+      // ~a[alpha] & ~b[beta] => ~out[sigma]
+      if (sigma < m) {
+        clause.clear();
+        if (alpha < p)
+          clause.push(a[alpha]);
+        if (beta < q)
+          clause.push(b[beta]);
+        clause.push(~out[sigma]);
+        solver.addClause(clause);
+      }
+    }
+  }
+  return out;
+}
+
+template <typename Solver>
+void TotalizerExact(Solver& solver, int k,
+                    const std::vector<Minisat::Lit>& xs) {
+  auto out = Totalize(solver, xs, 0, xs.size(), k + 1);
+  solver.addClause(out[k - 1]);
+  if (k < static_cast<int>(out.size()))
+    solver.addClause(~out[k]);
+}
+
+// Exact(k) with a concrete strategy, as resolved by ResolveCardinality().
+template <typename Solver>
+void ExactWith(Solver& solver, int k, const std::vector<Minisat::Lit>& xs,
+               Cardinality c) {
+  int n = xs.size();
+  if (c == Cardinality::Binomial || k <= 0 || k >= n) {
+    Exact(solver, k, xs);
+    return;
+  }
+  if (c == Cardinality::Totalizer) {
+    TotalizerExact(solver, k, xs);
+    return;
+  }
+
+  std::vector<Minisat::Lit> negated;
+  negated.reserve(n);
+  for (auto& x : xs)
+    negated.push_back(~x);
+  AtMost(solver, k, xs, c);
+  AtMost(solver, n - k, negated, c);
+}
+
+// Accumulates what each strategy emitted, and remembers the (n, k) shapes
+// that were encoded so that the alternatives can be compared on them.
+struct CardinalityStats {
+  struct Entry {
+    int64_t calls = 0;
+    int64_t clauses = 0;
+    int64_t vars = 0;
+  };
+
+  Entry entries[kCardinalityCount];
+  std::map<std::pair<int, int>, int64_t> shapes;
+
+  void Record(Cardinality c, int n, int k, int64_t clauses, int64_t vars) {
+    auto& e = entries[static_cast<int>(c)];
+    ++e.calls;
+    e.clauses += clauses;
+    e.vars += vars;
+    ++shapes[std::make_pair(n, k)];
+  }
+
+  void Print(std::ostream& out) const {
+    out << "cardinality encodings used:\n";
+    for (int i = 0; i < kCardinalityCount; ++i) {
+      auto& e = entries[i];
+      if (!e.calls)
+        continue;
+      out << "  " << std::setw(10) << std::left
+          << CardinalityName(static_cast<Cardinality>(i)) << std::right
+          << " calls " << std::setw(8) << e.calls
+          << " clauses " << std::setw(10) << e.clauses
+          << " aux vars " << std::setw(8) << e.vars << '\n';
+    }
+
+    out << "cardinality alternatives (clauses / aux vars per call):\n";
+    for (auto& shape : shapes) {
+      int n = shape.first.first;
+      int k = shape.first.second;
+      out << "  Exact(" << k << " of " << n << ") x" << shape.second << ":";
+      std::vector<Minisat::Lit> xs;
+      for (int i = 0; i < n; ++i)
+        xs.push_back(Minisat::mkLit(i));
+      for (int i = 1; i < kCardinalityCount; ++i) {
+        auto c = static_cast<Cardinality>(i);
+        ClauseCounter counter;
+        counter.vars = n;
+        ExactWith(counter, k, xs, ResolveCardinality(c, n, k));
+        out << ' ' << CardinalityName(c) << ' ' << counter.clauses << '/'
+            << counter.vars - n;
+      }
+      out << '\n';
+    }
+  }
+};
+
+// Exact(k) with strategy |c|, resolving Auto by (n, k) and recording the
+// emitted size into |stats| if given.
+template <typename Solver, typename T>
+void Exact(Solver& solver, int k, const T& xs, Cardinality c,
+           CardinalityStats* stats = nullptr) {
+  using std::begin;
+  using std::end;
+  std::vector<Minisat::Lit> lits(begin(xs), end(xs));
+  int n = lits.size();
+  c = ResolveCardinality(c, n, k);
+  if (!stats) {
+    ExactWith(solver, k, lits, c);
+    return;
+  }
+
+  CountingSink<Solver> sink(solver);
+  ExactWith(sink, k, lits, c);
+  stats->Record(c, n, k, sink.clauses, sink.vars);
+}
+
+#endif  // NUMBER_LINK_CARDINALITY_H_
@@ -0,0 +1,628 @@
+#ifndef NUMBER_LINK_CDCL_H_
+#define NUMBER_LINK_CDCL_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "minisat/core/Solver.h"
+
+// A compact CDCL solver on Minisat's literals, with a propagator that
+// reasons beyond the clauses.
+//
+// The core follows MiniSat: two watched literals, first-UIP learning with
+// local minimization, VSIDS on a binary heap, phase saving, Luby restarts
+// and halving the learnt clauses by glue and activity.
+//
+// Whenever unit propagation reaches a fixed point, it calls
+// |propagator.Propagate(*this, from)| with the position on the trail of
+// the first literal assigned since the last call at this level or below.
+// The propagator reads value() and level() and explains each inference
+// with a clause passed to Explain(): one whose literals are all false but
+// the first is that first literal's reason, and one whose literals are all
+// false is a conflict. Explanations are learnt like any other clause. A
+// propagator with an empty Propagate() leaves the plain CDCL core.
+template <typename Propagator>
+class CdclSolver {
+ public:
+  typedef Minisat::Lit Lit;
+  typedef Minisat::Var Var;
+
+  struct Stats {
+    uint64_t conflicts = 0;
+    uint64_t decisions = 0;
+    uint64_t propagations = 0;
+    uint64_t restarts = 0;
+    // Calls of the propagator, and the clauses it explained an inference
+    // or a conflict with.
+    uint64_t theory_calls = 0;
+    uint64_t theory_propagations = 0;
+    uint64_t theory_conflicts = 0;
+  };
+
+  explicit CdclSolver(Propagator& propagator) : propagator_(propagator) {}
+
+  CdclSolver(const CdclSolver&) = delete;
+  CdclSolver& operator=(const CdclSolver&) = delete;
+
+  Var NewVar() {
+    Var v = static_cast<Var>(level_.size());
+    values_.push_back(0);
+    values_.push_back(0);
+    level_.push_back(0);
+    reason_.push_back(kNoClause);
+    polarity_.push_back(true);
+    seen_.push_back(0);
+    activity_.push_back(0);
+    heap_index_.push_back(-1);
+    watches_.emplace_back();
+    watches_.emplace_back();
+    HeapInsert(v);
+    return v;
+  }
+
+  int nVars() const { return static_cast<int>(level_.size()); }
+  int nClauses() const { return problem_clauses_; }
+
+  // Adds a clause at the root. Returns false once the clauses contradict.
+  bool AddClause(const std::vector<Lit>& clause) {
+    if (!ok_)
+      return false;
+    auto& lits = added_;
+    lits = clause;
+    std::sort(lits.begin(), lits.end());
+    size_t n = 0;
+    for (size_t i = 0; i < lits.size(); ++i) {
+      if (value(lits[i]) > 0 ||
+          (i + 1 < lits.size() && lits[i + 1] == ~lits[i]))
+        return true;
+      if (value(lits[i]) < 0 || (n && lits[n - 1] == lits[i]))
+        continue;
+      lits[n++] = lits[i];
+    }
+    lits.resize(n);
+    if (lits.empty())
+      return ok_ = false;
+    if (lits.size() == 1) {
+      Enqueue(lits[0], kNoClause);
+      return ok_ = PropagateClauses() == kNoClause;
+    }
+    ++problem_clauses_;
+    Attach(lits, false, 0);
+    return true;
+  }
+
+  // Solves under |assumptions|. Returns whether there is a model, or false
+  // if interrupted, by an Interrupt() during the call or one since the last
+  // call returned. Either is used up by the return.
+  bool Solve(const std::vector<Lit>& assumptions = std::vector<Lit>()) {
+    model_.clear();
+    if (!ok_) {
+      interrupted_ = false;
+      return false;
+    }
+    assumptions_ = assumptions;
+    max_learnts_ = std::max(problem_clauses_ / 3.0, 1000.0);
+    int8_t status = 0;
+    for (int restarts = 0; !status && !interrupted_; ++restarts) {
+      status = Search(static_cast<int64_t>(Luby(2, restarts) * 100));
+      ++stats_.restarts;
+    }
+    if (status > 0) {
+      model_.resize(nVars());
+      for (Var v = 0; v < nVars(); ++v)
+        model_[v] = value(Minisat::mkLit(v)) > 0;
+    }
+    CancelUntil(0);
+    interrupted_ = false;
+    return status > 0;
+  }
+
+  // The value of |p| in the last model.
+  bool ModelValue(Lit p) const {
+    return model_[Minisat::var(p)] != Minisat::sign(p);
+  }
+
+  // 1 if |p| is true, -1 if false and 0 if unassigned.
+  int value(Lit p) const { return values_[Minisat::toInt(p)]; }
+  int level(Var v) const { return level_[v]; }
+  int decisionLevel() const { return static_cast<int>(trail_lim_.size()); }
+  int trail_size() const { return static_cast<int>(trail_.size()); }
+  Lit trail(int i) const { return trail_[i]; }
+
+  // Explains an inference of the propagator; see above. Takes effect once
+  // Propagate() returns.
+  void Explain(std::vector<Lit> lits) {
+    explanations_.push_back(std::move(lits));
+  }
+
+  const Stats& stats() const { return stats_; }
+
+  // Makes the running Solve(), or the next one if none is, return at its
+  // next restart. Safe from other threads.
+  void Interrupt() { interrupted_ = true; }
+
+ private:
+  enum { kNoClause = -1 };
+
+  struct Watcher {
+    int clause;
+    Lit blocker;
+  };
+
+  struct ClauseInfo {
+    int begin, size;
+    bool learnt;
+    int glue;
+    double activity;
+  };
+
+  Lit* Literals(int c) { return &literals_[clauses_[c].begin]; }
+
+  int Attach(const std::vector<Lit>& lits, bool learnt, int glue) {
+    int c = static_cast<int>(clauses_.size());
+    clauses_.push_back(ClauseInfo{static_cast<int>(literals_.size()),
+                                  static_cast<int>(lits.size()), learnt,
+                                  glue, 0});
+    literals_.insert(literals_.end(), lits.begin(), lits.end());
+    Watch(c);
+    if (learnt)
+      learnts_.push_back(c);
+    return c;
+  }
+
+  void Watch(int c) {
+    Lit* lits = Literals(c);
+    watches_[Minisat::toInt(~lits[0])].push_back(Watcher{c, lits[1]});
+    watches_[Minisat::toInt(~lits[1])].push_back(Watcher{c, lits[0]});
+  }
+
+  void Enqueue(Lit p, int reason) {
+    Var v = Minisat::var(p);
+    values_[Minisat::toInt(p)] = 1;
+    values_[Minisat::toInt(~p)] = -1;
+    level_[v] = decisionLevel();
+    reason_[v] = reason;
+    trail_.push_back(p);
+  }
+
+  void CancelUntil(int level) {
+    if (decisionLevel() <= level)
+      return;
+    for (size_t i = trail_.size(); i > trail_lim_[level]; --i) {
+      Lit p = trail_[i - 1];
+      Var v = Minisat::var(p);
+      values_[Minisat::toInt(p)] = values_[Minisat::toInt(~p)] = 0;
+      polarity_[v] = Minisat::sign(p);
+      HeapInsert(v);
+    }
+    trail_.resize(trail_lim_[level]);
+    trail_lim_.resize(level);
+    head_ = std::min(head_, trail_.size());
+    theory_head_ = std::min(theory_head_, trail_.size());
+  }
+
+  // Unit propagation over the clauses.
+  int PropagateClauses() {
+    while (head_ < trail_.size()) {
+      Lit p = trail_[head_++];
+      Lit false_lit = ~p;
+      ++stats_.propagations;
+      auto& ws = watches_[Minisat::toInt(p)];
+      size_t i = 0, j = 0;
+      while (i < ws.size()) {
+        Watcher w = ws[i++];
+        if (value(w.blocker) > 0) {
+          ws[j++] = w;
+          continue;
+        }
+        Lit* lits = Literals(w.clause);
+        if (lits[0] == false_lit)
+          std::swap(lits[0], lits[1]);
+        Watcher kept{w.clause, lits[0]};
+        if (lits[0] != w.blocker && value(lits[0]) > 0) {
+          ws[j++] = kept;
+          continue;
+        }
+        bool moved = false;
+        for (int k = 2; k < clauses_[w.clause].size; ++k) {
+          if (value(lits[k]) >= 0) {
+            std::swap(lits[1], lits[k]);
+            watches_[Minisat::toInt(~lits[1])].push_back(kept);
+            moved = true;
+            break;
+          }
+        }
+        if (moved)
+          continue;
+        ws[j++] = kept;
+        if (value(lits[0]) < 0) {
+          while (i < ws.size())
+            ws[j++] = ws[i++];
+          ws.resize(j);
+          head_ = trail_.size();
+          return w.clause;
+        }
+        Enqueue(lits[0], w.clause);
+      }
+      ws.resize(j);
+    }
+    return kNoClause;
+  }
+
+  // Unit propagation and the propagator to a common fixed point. Returns a
+  // conflicting clause, after going back to the highest level of its
+  // literals, or kNoClause.
+  int Propagate() {
+    for (;;) {
+      int conflict = PropagateClauses();
+      if (conflict != kNoClause)
+        return conflict;
+      if (theory_head_ == trail_.size() && !theory_fresh_)
+        return kNoClause;
+
+      size_t from = theory_head_;
+      theory_head_ = trail_.size();
+      theory_fresh_ = false;
+      ++stats_.theory_calls;
+      propagator_.Propagate(*this, static_cast<int>(from));
+      std::vector<std::vector<Lit>> explanations;
+      explanations.swap(explanations_);
+      int level = decisionLevel();
+      for (auto& lits : explanations) {
+        conflict = AddExplanation(&lits);
+        if (!ok_ || conflict != kNoClause)
+          return conflict;
+        if (decisionLevel() != level)
+          break;
+      }
+    }
+  }
+
+  // Adds a clause from the propagator, and enqueues its first literal or
+  // reports it as a conflict. Units are facts, so they go back to the root,
+  // and the rest of the round's explanations are dropped.
+  int AddExplanation(std::vector<Lit>* clause) {
+    auto& lits = *clause;
+    size_t unassigned = 0;
+    for (size_t i = 0; i < lits.size(); ++i) {
+      if (value(lits[i]) > 0)
+        return kNoClause;
+      if (value(lits[i]) == 0)
+        std::swap(lits[i], lits[unassigned++]);
+    }
+    if (lits.size() <= 1) {
+      CancelUntil(0);
+      if (lits.empty() || value(lits[0]) < 0)
+        ok_ = false;
+      else if (value(lits[0]) == 0)
+        Enqueue(lits[0], kNoClause);
+      return kNoClause;
+    }
+    if (unassigned >= 2) {
+      Attach(lits, true, Glue(lits));
+      return kNoClause;
+    }
+
+    // The false literals by decreasing level, so that the watches are the
+    // last to be unassigned.
+    std::sort(lits.begin() + unassigned, lits.end(), [&](Lit p, Lit q) {
+      return level(Minisat::var(p)) > level(Minisat::var(q));
+    });
+    int c = Attach(lits, true, Glue(lits));
+    if (unassigned) {
+      ++stats_.theory_propagations;
+      Enqueue(lits[0], c);
+      return kNoClause;
+    }
+    ++stats_.theory_conflicts;
+    CancelUntil(level(Minisat::var(lits[0])));
+    return c;
+  }
+
+  int Glue(const std::vector<Lit>& lits) {
+    ++glue_stamp_;
+    int glue = 0;
+    for (auto& p : lits) {
+      int l = level(Minisat::var(p));
+      if (static_cast<int>(glue_stamps_.size()) <= l)
+        glue_stamps_.resize(l + 1, 0);
+      if (glue_stamps_[l] != glue_stamp_) {
+        glue_stamps_[l] = glue_stamp_;
+        ++glue;
+      }
+    }
+    return glue;
+  }
+
+  // First-UIP conflict analysis. Fills |learnt| with the asserting literal
+  // first and one of the highest level among the rest second.
+  void Analyze(int conflict, std::vector<Lit>* learnt) {
+    learnt->assign(1, Lit());
+    std::vector<Var> analyzed;
+    int paths = 0;
+    Lit p = Minisat::lit_Undef;
+    int index = static_cast<int>(trail_.size()) - 1;
+    do {
+      auto& info = clauses_[conflict];
+      if (info.learnt)
+        BumpClause(conflict);
+      Lit* lits = Literals(conflict);
+      for (int j = p == Minisat::lit_Undef ? 0 : 1; j < info.size; ++j) {
+        Var v = Minisat::var(lits[j]);
+        if (seen_[v] || level_[v] == 0)
+          continue;
+        BumpVar(v);
+        seen_[v] = 1;
+        analyzed.push_back(v);
+        if (level_[v] >= decisionLevel())
+          ++paths;
+        else
+          learnt->push_back(lits[j]);
+      }
+      while (!seen_[Minisat::var(trail_[index])])
+        --index;
+      p = trail_[index--];
+      conflict = reason_[Minisat::var(p)];
+      seen_[Minisat::var(p)] = 0;
+      --paths;
+    } while (paths > 0);
+    (*learnt)[0] = ~p;
+
+    // Drop literals implied by the others.
+    size_t n = 1;
+    for (size_t i = 1; i < learnt->size(); ++i) {
+      int reason = reason_[Minisat::var((*learnt)[i])];
+      bool implied = reason != kNoClause;
+      for (int j = 1; implied && j < clauses_[reason].size; ++j) {
+        Var v = Minisat::var(Literals(reason)[j]);
+        implied = seen_[v] || level_[v] == 0;
+      }
+      if (!implied)
+        (*learnt)[n++] = (*learnt)[i];
+    }
+    learnt->resize(n);
+    for (Var v : analyzed)
+      seen_[v] = 0;
+
+    for (size_t i = 2; i < learnt->size(); ++i) {
+      if (level_[Minisat::var((*learnt)[i])] >
+          level_[Minisat::var((*learnt)[1])])
+        std::swap((*learnt)[1], (*learnt)[i]);
+    }
+  }
+
+  // Returns 1 on a model, -1 if there is none under the assumptions and 0
+  // after |budget| conflicts.
+  int8_t Search(int64_t budget) {
+    std::vector<Lit> learnt;
+    for (;;) {
+      int conflict = Propagate();
+      if (!ok_)
+        return -1;
+      if (conflict != kNoClause) {
+        ++stats_.conflicts;
+        --budget;
+        if (decisionLevel() == 0) {
+          ok_ = false;
+          return -1;
+        }
+        Analyze(conflict, &learnt);
+        if (learnt.size() == 1) {
+          CancelUntil(0);
+          Enqueue(learnt[0], kNoClause);
+        } else {
+          CancelUntil(level_[Minisat::var(learnt[1])]);
+          Enqueue(learnt[0], Attach(learnt, true, Glue(learnt)));
+        }
+        var_inc_ /= 0.95;
+        clause_inc_ /= 0.999;
+        continue;
+      }
+
+      if (budget <= 0 || interrupted_) {
+        CancelUntil(0);
+        return 0;
+      }
+      if (learnts_.size() >= max_learnts_ + trail_.size()) {
+        ReduceLearnts();
+        max_learnts_ *= 1.1;
+      }
+
+      Lit next = Minisat::lit_Undef;
+      while (decisionLevel() < static_cast<int>(assumptions_.size())) {
+        Lit p = assumptions_[decisionLevel()];
+        if (value(p) < 0)
+          return -1;
+        if (value(p) > 0) {
+          trail_lim_.push_back(trail_.size());
+        } else {
+          next = p;
+          break;
+        }
+      }
+      if (next == Minisat::lit_Undef) {
+        while (!heap_.empty() && next == Minisat::lit_Undef) {
+          Var v = HeapPop();
+          if (value(Minisat::mkLit(v)) == 0)
+            next = Minisat::mkLit(v, polarity_[v]);
+        }
+        if (next == Minisat::lit_Undef)
+          return 1;
+        ++stats_.decisions;
+      }
+      trail_lim_.push_back(trail_.size());
+      Enqueue(next, kNoClause);
+    }
+  }
+
+  // Deletes the worse half of the learnt clauses that are not reasons,
+  // keeping those of glue 2 or less, then compacts the clause arena.
+  void ReduceLearnts() {
+    std::sort(learnts_.begin(), learnts_.end(), [&](int a, int b) {
+      if (clauses_[a].glue != clauses_[b].glue)
+        return clauses_[a].glue > clauses_[b].glue;
+      return clauses_[a].activity < clauses_[b].activity;
+    });
+    std::vector<char> removed(clauses_.size(), 0);
+    for (size_t i = 0; i < learnts_.size() / 2; ++i) {
+      int c = learnts_[i];
+      Lit p = Literals(c)[0];
+      bool locked = value(p) > 0 && reason_[Minisat::var(p)] == c;
+      if (!locked && clauses_[c].glue > 2)
+        removed[c] = 1;
+    }
+
+    std::vector<int> moved(clauses_.size(), kNoClause);
+    std::vector<ClauseInfo> clauses;
+    std::vector<Lit> literals;
+    for (size_t c = 0; c < clauses_.size(); ++c) {
+      if (removed[c])
+        continue;
+      moved[c] = static_cast<int>(clauses.size());
+      ClauseInfo info = clauses_[c];
+      info.begin = static_cast<int>(literals.size());
+      literals.insert(literals.end(), Literals(c), Literals(c) + info.size);
+      clauses.push_back(info);
+    }
+    clauses_.swap(clauses);
+    literals_.swap(literals);
+    for (auto& reason : reason_) {
+      if (reason != kNoClause)
+        reason = moved[reason];
+    }
+    learnts_.clear();
+    for (auto& ws : watches_)
+      ws.clear();
+    for (size_t c = 0; c < clauses_.size(); ++c) {
+      Watch(c);
+      if (clauses_[c].learnt)
+        learnts_.push_back(c);
+    }
+  }
+
+  void BumpVar(Var v) {
+    if ((activity_[v] += var_inc_) > 1e100) {
+      for (auto& a : activity_)
+        a *= 1e-100;
+      var_inc_ *= 1e-100;
+    }
+    if (heap_index_[v] >= 0)
+      HeapUp(heap_index_[v]);
+  }
+
+  void BumpClause(int c) {
+    if ((clauses_[c].activity += clause_inc_) > 1e20) {
+      for (int l : learnts_)
+        clauses_[l].activity *= 1e-20;
+      clause_inc_ *= 1e-20;
+    }
+  }
+
+  static double Luby(double y, int x) {
+    int size = 1, seq = 0;
+    while (size < x + 1) {
+      ++seq;
+      size = 2 * size + 1;
+    }
+    while (size - 1 != x) {
+      size = (size - 1) >> 1;
+      --seq;
+      x = x % size;
+    }
+    return std::pow(y, seq);
+  }
+
+  // A max-heap of the unassigned variables by activity.
+  void HeapInsert(Var v) {
+    if (heap_index_[v] >= 0)
+      return;
+    heap_index_[v] = static_cast<int>(heap_.size());
+    heap_.push_back(v);
+    HeapUp(heap_index_[v]);
+  }
+
+  Var HeapPop() {
+    Var top = heap_[0];
+    heap_[0] = heap_.back();
+    heap_index_[heap_[0]] = 0;
+    heap_index_[top] = -1;
+    heap_.pop_back();
+    if (!heap_.empty())
+      HeapDown(0);
+    return top;
+  }
+
+  void HeapUp(int i) {
+    Var v = heap_[i];
+    while (i > 0 && activity_[heap_[(i - 1) / 2]] < activity_[v]) {
+      heap_[i] = heap_[(i - 1) / 2];
+      heap_index_[heap_[i]] = i;
+      i = (i - 1) / 2;
+    }
+    heap_[i] = v;
+    heap_index_[v] = i;
+  }
+
+  void HeapDown(int i) {
+    Var v = heap_[i];
+    int n = static_cast<int>(heap_.size());
+    for (;;) {
+      int child = 2 * i + 1;
+      if (child >= n)
+        break;
+      if (child + 1 < n && activity_[heap_[child + 1]] > activity_[heap_[child]])
+        ++child;
+      if (activity_[heap_[child]] <= activity_[v])
+        break;
+      heap_[i] = heap_[child];
+      heap_index_[heap_[i]] = i;
+      i = child;
+    }
+    heap_[i] = v;
+    heap_index_[v] = i;
+  }
+
+  Propagator& propagator_;
+  bool ok_ = true;
+  std::atomic<bool> interrupted_{false};
+  Stats stats_;
+  int problem_clauses_ = 0;
+  double max_learnts_ = 0;
+
+  std::vector<ClauseInfo> clauses_;
+  std::vector<Lit> literals_;
+  std::vector<int> learnts_;
+  std::vector<std::vector<Watcher>> watches_;
+
+  // Per literal, and per variable.
+  std::vector<int8_t> values_;
+  std::vector<int> level_, reason_;
+  std::vector<char> polarity_, seen_;
+  std::vector<double> activity_;
+
+  std::vector<Lit> trail_;
+  std::vector<size_t> trail_lim_;
+  size_t head_ = 0, theory_head_ = 0;
+  bool theory_fresh_ = true;
+  std::vector<std::vector<Lit>> explanations_;
+  std::vector<Lit> added_, assumptions_;
+  std::vector<bool> model_;
+
+  std::vector<Var> heap_;
+  std::vector<int> heap_index_;
+  double var_inc_ = 1, clause_inc_ = 1;
+  std::vector<int> glue_stamps_;
+  int glue_stamp_ = 0;
+};
+
+// A propagator that adds nothing, for the plain CDCL core.
+struct NoPropagator {
+  template <typename Solver>
+  void Propagate(Solver&, int) {}
+};
+
+#endif  // NUMBER_LINK_CDCL_H_
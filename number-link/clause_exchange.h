@@ -0,0 +1,95 @@
+#ifndef NUMBER_LINK_CLAUSE_EXCHANGE_H_
+#define NUMBER_LINK_CLAUSE_EXCHANGE_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "minisat/core/Solver.h"
+
+// A lock-free broadcast ring of short clauses between solver threads.
+//
+// Writers claim a ticket with fetch_add, then the slot by a CAS of its
+// sequence number from the even value it held to 2 * ticket + 1, and
+// publish it by storing 2 * ticket + 2 after filling it in. A slot under
+// construction thus reads as odd, and a writer that finds the slot being
+// written or already taken by a later ticket drops its clause rather than
+// mix its literals into another's. Readers skip a ticket whose slot holds
+// anything else than its own values, which also loses the rare clause of a
+// writer that has not claimed its slot yet. Each reader keeps its own cursor. Slots
+// that were overwritten before the reader got to them are skipped, so a
+// slow reader loses clauses but never blocks writers.
+class ClauseExchange {
+ public:
+  static const int kMaxSize = 8;
+  static const uint64_t kSlots = 1 << 14;
+
+  ClauseExchange() : slots_(new Slot[kSlots]) {
+    for (uint64_t i = 0; i < kSlots; ++i)
+      slots_[i].seq.store(0, std::memory_order_relaxed);
+  }
+
+  ClauseExchange(const ClauseExchange&) = delete;
+  ClauseExchange& operator=(const ClauseExchange&) = delete;
+
+  template <typename Clause>
+  void Publish(int source, const Clause& c) {
+    if (c.size() > kMaxSize)
+      return;
+    uint64_t ticket = head_.fetch_add(1, std::memory_order_relaxed);
+    auto& slot = slots_[ticket % kSlots];
+    uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+    if (seq % 2 || seq > 2 * ticket ||
+        !slot.seq.compare_exchange_strong(seq, 2 * ticket + 1,
+                                          std::memory_order_relaxed))
+      return;
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.source.store(source, std::memory_order_relaxed);
+    slot.size.store(c.size(), std::memory_order_relaxed);
+    for (int i = 0; i < c.size(); ++i)
+      slot.lits[i].store(Minisat::toInt(c[i]), std::memory_order_relaxed);
+    slot.seq.store(2 * ticket + 2, std::memory_order_release);
+  }
+
+  // Calls |f| with each clause published by others since |*cursor|.
+  template <typename F>
+  void Collect(int self, uint64_t* cursor, F f) {
+    uint64_t head = head_.load(std::memory_order_acquire);
+    if (head - *cursor > kSlots)
+      *cursor = head - kSlots;
+
+    Minisat::vec<Minisat::Lit> clause;
+    for (; *cursor < head; ++*cursor) {
+      auto& slot = slots_[*cursor % kSlots];
+      uint64_t seq = slot.seq.load(std::memory_order_acquire);
+      if (seq == 2 * *cursor + 1)
+        return;  // Still being written; retry from here next time.
+      if (seq != 2 * *cursor + 2)
+        continue;  // Dropped, or overwritten by a later ticket.
+
+      int source = slot.source.load(std::memory_order_relaxed);
+      int size = slot.size.load(std::memory_order_relaxed);
+      clause.clear();
+      for (int i = 0; i < size && i < kMaxSize; ++i)
+        clause.push(
+            Minisat::toLit(slot.lits[i].load(std::memory_order_relaxed)));
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (slot.seq.load(std::memory_order_relaxed) != seq || source == self)
+        continue;
+      f(clause);
+    }
+  }
+
+ private:
+  struct Slot {
+    std::atomic<uint64_t> seq;
+    std::atomic<int> source;
+    std::atomic<int> size;
+    std::atomic<int> lits[kMaxSize];
+  };
+
+  std::atomic<uint64_t> head_{0};
+  std::unique_ptr<Slot[]> slots_;
+};
+
+#endif  // NUMBER_LINK_CLAUSE_EXCHANGE_H_
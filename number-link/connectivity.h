@@ -0,0 +1,244 @@
+#ifndef NUMBER_LINK_CONNECTIVITY_H_
+#define NUMBER_LINK_CONNECTIVITY_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "minisat/core/Solver.h"
+
+// A propagator for CdclSolver that keeps every label connected.
+//
+// For each label it searches from the first endpoint through the cells that
+// may still take the label, over the edges that may still be on. The
+// boundary of what it reaches is cut off by false literals: an edge that is
+// off, or a cell outside that cannot take the label. So
+//  - if the other endpoint is not reached, the boundary is a conflict, and
+//  - any cell that is not reached cannot take the label, which the boundary
+//    explains.
+// The second rule also rules out loops away from the path, and together
+// with each cell needing a label, regions that no label can fill.
+//
+// Literals on var_Undef are constants, as in Instance, and never appear in
+// explanations. The search is incremental per label: each keeps what it
+// reached, and is searched again only once a literal inside that becomes
+// false, which the propagator's own inferences never are. After
+// backtracking, which may grow what a label reaches, any false literal of a
+// label triggers a search.
+class ConnectivityPropagator {
+ public:
+  typedef Minisat::Lit Lit;
+
+  // |assignments| holds the literal of label k at cell c at c * pairs + k,
+  // and |east_west| and |north_south| the edges as Instance lays them out.
+  // |endpoints| has the two cells of each label; others are skipped.
+  ConnectivityPropagator(int width, int height, int pairs,
+                         std::vector<Lit> assignments,
+                         std::vector<Lit> east_west,
+                         std::vector<Lit> north_south,
+                         const std::vector<std::vector<int>>& endpoints)
+      : width_(width), height_(height), pairs_(pairs),
+        assignments_(std::move(assignments)),
+        east_west_(std::move(east_west)), north_south_(std::move(north_south)),
+        endpoints_(endpoints), dirty_(pairs, 1), current_(pairs, 0),
+        reached_(pairs * width * height, 0), stamps_(pairs, 0) {
+    auto watch = [&](const Lit& x, int k, int c, int d) {
+      if (IsVariable(x)) {
+        int v = Minisat::var(x);
+        if (static_cast<int>(watches_.size()) <= v)
+          watches_.resize(v + 1);
+        watches_[v].push_back(Watch{~x, k, c, d});
+      }
+    };
+    for (int c = 0; c < width * height; ++c) {
+      for (int k = 0; k < pairs; ++k)
+        watch(Assignment(c, k), k, c, c);
+    }
+    // An edge matters to the labels both its cells may take.
+    ForEachLink([&](int c, int d, const Lit& e) {
+      for (int k = 0; k < pairs; ++k) {
+        if (Assignment(c, k) != Never() && Assignment(d, k) != Never())
+          watch(e, k, c, d);
+      }
+    });
+  }
+
+  template <typename Solver>
+  void Propagate(Solver& solver, int from) {
+    if (from < end_)
+      std::fill(current_.begin(), current_.end(), 0);
+    end_ = solver.trail_size();
+    for (int i = from; i < end_; ++i) {
+      Lit p = solver.trail(i);
+      int v = Minisat::var(p);
+      if (v >= static_cast<int>(watches_.size()))
+        continue;
+      for (auto& watch : watches_[v]) {
+        int k = watch.label;
+        if (watch.lit == p &&
+            (!current_[k] || Reached(k, watch.cell) || Reached(k, watch.other)))
+          dirty_[k] = 1;
+      }
+    }
+
+    for (int k = 0; k < pairs_; ++k) {
+      if (!dirty_[k] || endpoints_[k].size() != 2)
+        continue;
+      dirty_[k] = 0;
+      current_[k] = 1;
+      if (!PropagateLabel(solver, k))
+        break;
+    }
+  }
+
+  int64_t searches() const { return searches_; }
+
+ private:
+  static bool IsVariable(const Lit& x) {
+    return Minisat::var(x) != var_Undef;
+  }
+
+  // The always-false literal, for labels outside a cell's domain.
+  static Lit Never() { return Minisat::mkLit(var_Undef, true); }
+
+  const Lit& Assignment(int c, int k) const {
+    return assignments_[c * pairs_ + k];
+  }
+
+  bool Reached(int k, int c) const {
+    return reached_[k * width_ * height_ + c] == stamps_[k];
+  }
+
+  // Calls |f| with each pair of neighbouring cells and the edge between.
+  template <typename F>
+  void ForEachLink(F f) const {
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 1; j < width_; ++j)
+        f(i * width_ + j - 1, i * width_ + j,
+          east_west_[i * (width_ + 1) + j]);
+    }
+    for (int i = 1; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j)
+        f((i - 1) * width_ + j, i * width_ + j, north_south_[i * width_ + j]);
+    }
+  }
+
+  // Calls |f| with each neighbour of cell |c| and the edge to it.
+  template <typename F>
+  void ForEachNeighbour(int c, F f) const {
+    int i = c / width_, j = c % width_;
+    if (i > 0)
+      f(c - width_, north_south_[i * width_ + j]);
+    if (i + 1 < height_)
+      f(c + width_, north_south_[(i + 1) * width_ + j]);
+    if (j > 0)
+      f(c - 1, east_west_[i * (width_ + 1) + j]);
+    if (j + 1 < width_)
+      f(c + 1, east_west_[i * (width_ + 1) + j + 1]);
+  }
+
+  template <typename Solver>
+  static bool IsFalse(const Solver& solver, const Lit& x) {
+    return IsVariable(x) ? solver.value(x) < 0 : Minisat::sign(x);
+  }
+
+  // Searches label |k| and explains what it finds. Returns false on a
+  // conflict.
+  template <typename Solver>
+  bool PropagateLabel(Solver& solver, int k) {
+    ++searches_;
+    int stamp = ++stamps_[k];
+    int* reached = &reached_[k * width_ * height_];
+    int source = endpoints_[k][0], target = endpoints_[k][1];
+    queue_.assign(1, source);
+    reached[source] = stamp;
+    for (size_t q = 0; q < queue_.size(); ++q) {
+      ForEachNeighbour(queue_[q], [&](int d, const Lit& e) {
+        if (reached[d] != stamp && !IsFalse(solver, e) &&
+            !IsFalse(solver, Assignment(d, k))) {
+          reached[d] = stamp;
+          queue_.push_back(d);
+        }
+      });
+    }
+
+    bool boundary_done = false;
+    auto explain = [&](const Lit* first) {
+      if (!boundary_done) {
+        Boundary(solver, k);
+        boundary_done = true;
+      }
+      std::vector<Lit> clause;
+      if (first)
+        clause.push_back(*first);
+      clause.insert(clause.end(), boundary_.begin(), boundary_.end());
+      solver.Explain(std::move(clause));
+    };
+    if (reached[target] != stamp) {
+      explain(nullptr);
+      return false;
+    }
+    for (int c = 0; c < width_ * height_; ++c) {
+      const Lit& x = Assignment(c, k);
+      if (reached[c] == stamp || IsFalse(solver, x))
+        continue;
+      Lit off = ~x;
+      explain(&off);
+      if (solver.value(x) > 0)
+        return false;
+    }
+    return true;
+  }
+
+  // Collects in |boundary_| a false literal cutting off each neighbour of
+  // the reached cells that was not reached: its edge or its label,
+  // whichever was decided first.
+  template <typename Solver>
+  void Boundary(const Solver& solver, int k) {
+    boundary_.clear();
+    for (int c : queue_) {
+      ForEachNeighbour(c, [&](int d, const Lit& e) {
+        if (Reached(k, d))
+          return;
+        const Lit& x = Assignment(d, k);
+        bool edge = IsFalse(solver, e);
+        if (edge && IsFalse(solver, x) && IsVariable(e) &&
+            (!IsVariable(x) || solver.level(Minisat::var(x)) <
+                                   solver.level(Minisat::var(e))))
+          edge = false;
+        const Lit& cut = edge ? e : x;
+        if (IsVariable(cut))
+          boundary_.push_back(cut);
+      });
+    }
+    std::sort(boundary_.begin(), boundary_.end());
+    boundary_.erase(std::unique(boundary_.begin(), boundary_.end()),
+                    boundary_.end());
+  }
+
+  int width_, height_, pairs_;
+  std::vector<Lit> assignments_, east_west_, north_south_;
+  std::vector<std::vector<int>> endpoints_;
+  // A literal whose falsity touches label |label| at cells |cell| and
+  // |other|, as the literal that is then true.
+  struct Watch {
+    Lit lit;
+    int label, cell, other;
+  };
+  // The watches on each variable.
+  std::vector<std::vector<Watch>> watches_;
+  // Per label, whether to search it again, and whether what it reached was
+  // found on the current branch.
+  std::vector<char> dirty_, current_;
+  // The end of the trail at the last call.
+  int end_ = 0;
+  // Cell c was reached by label k in its last search if
+  // reached_[k * cells + c] is stamps_[k].
+  std::vector<int> reached_, stamps_;
+  std::vector<int> queue_;
+  std::vector<Lit> boundary_;
+  int64_t searches_ = 0;
+};
+
+#endif  // NUMBER_LINK_CONNECTIVITY_H_
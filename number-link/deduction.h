@@ -0,0 +1,210 @@
+#ifndef NUMBER_LINK_DEDUCTION_H_
+#define NUMBER_LINK_DEDUCTION_H_
+
+#include <initializer_list>
+#include <numeric>
+#include <vector>
+
+// Local reasoning on the grid, to fix what it can before any search.
+//
+// Edges are laid out as in Instance: |east_west| has width + 1 entries per
+// row and |north_south| width entries for each of height + 1 rows, the outer
+// ones being walls. The rules, run to a fixed point:
+//
+//  - Degree: an endpoint needs one edge and any other cell two. Once a cell
+//    has them its other edges are off, and once it has only as many left as
+//    it needs they are all on. This covers corners, forced neighbours and
+//    dead ends.
+//  - Fragments: the edges that are on join cells into path fragments. An
+//    edge inside a fragment would close a loop, and one between fragments
+//    of different labels would join them, so both are off.
+//  - No U-turns, if asked for: under the spanning unique assumption, cells
+//    of one path that are adjacent are linked, so three inner edges of a
+//    2x2 block would force the fourth and close a loop. Once two are on the
+//    other two are off.
+//
+// Each round is O(cells).
+class Deduction {
+ public:
+  enum State : char {
+    Unknown, Off, On
+  };
+
+  // |givens| holds the label index of each endpoint cell and -1 elsewhere.
+  Deduction(int width, int height, const std::vector<int>& givens,
+            bool no_u_turns)
+      : width_(width), height_(height), givens_(givens),
+        no_u_turns_(no_u_turns),
+        east_west_((width + 1) * height, Unknown),
+        north_south_(width * (height + 1), Unknown),
+        parent_(width * height), labels_(givens) {
+    for (int i = 0; i < height; ++i) {
+      east_west_[i * (width + 1)] = Off;
+      east_west_[i * (width + 1) + width] = Off;
+    }
+    for (int j = 0; j < width; ++j) {
+      north_south_[j] = Off;
+      north_south_[height * width + j] = Off;
+    }
+  }
+
+  // Runs the rules to a fixed point. Returns false if they contradict.
+  bool Run() {
+    for (bool changed = true; changed;) {
+      ++rounds_;
+      changed = false;
+      if (!Degrees(&changed) || !Fragments(&changed))
+        return false;
+      if (no_u_turns_ && !UTurns(&changed))
+        return false;
+    }
+    return true;
+  }
+
+  State east_west(int p) const { return east_west_[p]; }
+  State north_south(int p) const { return north_south_[p]; }
+
+  // The label of the fragment of cell |c| after Run(), or -1 if it has no
+  // endpoint.
+  int label(int c) const { return labels_[c]; }
+
+  // Whether Run() decided every edge.
+  bool complete() const {
+    for (auto* edges : {&east_west_, &north_south_}) {
+      for (State s : *edges) {
+        if (s == Unknown)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  int rounds() const { return rounds_; }
+
+ private:
+  // The edges of cell (i, j): north, south, east and west.
+  void Edges(int i, int j, State* edges[4]) {
+    edges[0] = &north_south_[i * width_ + j];
+    edges[1] = &north_south_[(i + 1) * width_ + j];
+    edges[2] = &east_west_[i * (width_ + 1) + j + 1];
+    edges[3] = &east_west_[i * (width_ + 1) + j];
+  }
+
+  bool Degrees(bool* changed) {
+    State* edges[4];
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j) {
+        Edges(i, j, edges);
+        int need = givens_[i * width_ + j] >= 0 ? 1 : 2;
+        int on = 0, unknown = 0;
+        for (auto* e : edges) {
+          on += *e == On;
+          unknown += *e == Unknown;
+        }
+        if (on > need || on + unknown < need)
+          return false;
+        if (!unknown || (on < need && on + unknown > need))
+          continue;
+        for (auto* e : edges) {
+          if (*e == Unknown)
+            *e = on == need ? Off : On;
+        }
+        *changed = true;
+      }
+    }
+    return true;
+  }
+
+  int Find(int c) {
+    while (parent_[c] != c)
+      c = parent_[c] = parent_[parent_[c]];
+    return c;
+  }
+
+  // Calls |f| with each edge between cells and the two cells it joins.
+  template <typename F>
+  void ForEachLink(F f) {
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 1; j < width_; ++j)
+        f(&east_west_[i * (width_ + 1) + j], i * width_ + j - 1,
+          i * width_ + j);
+    }
+    for (int i = 1; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j)
+        f(&north_south_[i * width_ + j], (i - 1) * width_ + j,
+          i * width_ + j);
+    }
+  }
+
+  bool Fragments(bool* changed) {
+    std::iota(parent_.begin(), parent_.end(), 0);
+    std::vector<int> roots = givens_;
+    bool ok = true;
+    ForEachLink([&](State* e, int c, int d) {
+      if (*e != On)
+        return;
+      int rc = Find(c), rd = Find(d);
+      if (rc == rd || (roots[rc] >= 0 && roots[rd] >= 0 &&
+                       roots[rc] != roots[rd])) {
+        ok = false;
+        return;
+      }
+      parent_[rc] = rd;
+      if (roots[rd] < 0)
+        roots[rd] = roots[rc];
+    });
+    if (!ok)
+      return false;
+
+    ForEachLink([&](State* e, int c, int d) {
+      if (*e != Unknown)
+        return;
+      int rc = Find(c), rd = Find(d);
+      if (rc == rd || (roots[rc] >= 0 && roots[rd] >= 0 &&
+                       roots[rc] != roots[rd])) {
+        *e = Off;
+        *changed = true;
+      }
+    });
+    for (size_t c = 0; c < labels_.size(); ++c)
+      labels_[c] = roots[Find(c)];
+    return true;
+  }
+
+  bool UTurns(bool* changed) {
+    for (int i = 0; i + 1 < height_; ++i) {
+      for (int j = 0; j + 1 < width_; ++j) {
+        State* inner[] = {
+          &east_west_[i * (width_ + 1) + j + 1],
+          &east_west_[(i + 1) * (width_ + 1) + j + 1],
+          &north_south_[(i + 1) * width_ + j],
+          &north_south_[(i + 1) * width_ + j + 1],
+        };
+        int on = 0, unknown = 0;
+        for (auto* e : inner) {
+          on += *e == On;
+          unknown += *e == Unknown;
+        }
+        if (on > 2)
+          return false;
+        if (on < 2 || !unknown)
+          continue;
+        for (auto* e : inner) {
+          if (*e == Unknown)
+            *e = Off;
+        }
+        *changed = true;
+      }
+    }
+    return true;
+  }
+
+  int width_, height_;
+  std::vector<int> givens_;
+  bool no_u_turns_;
+  std::vector<State> east_west_, north_south_;
+  std::vector<int> parent_, labels_;
+  int rounds_ = 0;
+};
+
+#endif  // NUMBER_LINK_DEDUCTION_H_
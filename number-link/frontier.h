@@ -0,0 +1,286 @@
+#ifndef NUMBER_LINK_FRONTIER_H_
+#define NUMBER_LINK_FRONTIER_H_
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Counts and enumerates all solutions by frontier-based dynamic programming.
+//
+// Cells are swept row by row, along the shorter side of the board. A state
+// is what crosses the frontier between swept and unswept cells: for each
+// column the edge down from its last swept cell, and the edge right from
+// the last swept cell. Each edge is absent, the loose end of a fragment
+// whose other end is at an endpoint (then it carries that label), or one of
+// the two loose ends of a fragment with no endpoint yet (then it carries an
+// id shared with the other end). Equal states are merged with their counts
+// added, so the work grows with the width and not with the area.
+//
+// With |keep_arcs| every transition is kept, which makes the layers a
+// decision diagram of all solutions that Enumerate() walks back from the
+// end.
+class FrontierCounter {
+ public:
+  typedef unsigned __int128 Count;
+
+  // |givens| holds the label index of each endpoint cell and -1 elsewhere.
+  FrontierCounter(int width, int height, int pairs,
+                  const std::vector<int>& givens, bool keep_arcs)
+      : transposed_(width > height),
+        width_(transposed_ ? height : width),
+        height_(transposed_ ? width : height),
+        pairs_(pairs), keep_arcs_(keep_arcs),
+        givens_(width * height) {
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j)
+        givens_[i * width_ + j] = givens[Original(i, j)];
+    }
+  }
+
+  // Whether the labels and fragment ids fit the frontier's char slots.
+  bool supported() const { return pairs_ + 2 * width_ + 2 < 128; }
+
+  // Runs the sweep and returns the number of solutions.
+  Count Run() {
+    std::vector<State> states(1, State(width_ + 1, 0));
+    std::vector<Count> counts(1, 1);
+    layers_.clear();
+    for (int c = 0; c < width_ * height_; ++c) {
+      std::unordered_map<State, int> index;
+      std::vector<State> next_states;
+      std::vector<Count> next_counts;
+      Layer layer;
+      for (size_t s = 0; s < states.size(); ++s) {
+        Step(c, states[s], [&](State next, int choice) {
+          Canonicalize(&next);
+          auto inserted = index.insert(
+              std::make_pair(next, static_cast<int>(next_states.size())));
+          if (inserted.second) {
+            next_states.push_back(next);
+            next_counts.push_back(0);
+          }
+          int to = inserted.first->second;
+          next_counts[to] += counts[s];
+          if (keep_arcs_)
+            layer.arcs.push_back(Arc{static_cast<int>(s), to, choice});
+        });
+      }
+      max_states_ = std::max(max_states_, next_states.size());
+      if (keep_arcs_) {
+        layer.states = next_states.size();
+        layers_.push_back(std::move(layer));
+      }
+      states = std::move(next_states);
+      counts = std::move(next_counts);
+    }
+
+    final_ = -1;
+    for (size_t s = 0; s < states.size(); ++s) {
+      if (std::count(states[s].begin(), states[s].end(), 0) ==
+          static_cast<int>(states[s].size())) {
+        final_ = s;
+        return counts[s];
+      }
+    }
+    return 0;
+  }
+
+  // Calls |f| with the edges of up to |limit| solutions (all if 0), in
+  // Instance's east_west and north_south layout, after a Run() with arcs.
+  // Returns how many it called |f| with.
+  template <typename F>
+  int64_t Enumerate(int64_t limit, F f) const {
+    if (!keep_arcs_ || final_ < 0)
+      return 0;
+    std::vector<std::vector<std::vector<const Arc*>>> incoming(
+        layers_.size());
+    for (size_t t = 0; t < layers_.size(); ++t) {
+      incoming[t].resize(layers_[t].states);
+      for (auto& arc : layers_[t].arcs)
+        incoming[t][arc.to].push_back(&arc);
+    }
+
+    int cells = width_ * height_;
+    std::vector<int> choices(cells);
+    int64_t found = 0;
+    // The states walked back through from the end, each with the next of
+    // its incoming arcs to try; the top one is a state after cell
+    // cells - stack.size().
+    std::vector<std::pair<int, size_t>> stack;
+    auto emit = [&]() {
+      std::vector<char> east_west, north_south;
+      Edges(choices, &east_west, &north_south);
+      f(east_west, north_south);
+      ++found;
+    };
+    if (cells == 0) {
+      emit();
+      return found;
+    }
+    stack.push_back(std::make_pair(final_, 0));
+    while (!stack.empty() && (!limit || found < limit)) {
+      int c = cells - static_cast<int>(stack.size());
+      auto& top = stack.back();
+      auto& arcs = incoming[c][top.first];
+      if (top.second == arcs.size()) {
+        stack.pop_back();
+        continue;
+      }
+      auto* arc = arcs[top.second++];
+      choices[c] = arc->choice;
+      if (c == 0)
+        emit();
+      else
+        stack.push_back(std::make_pair(arc->from, 0));
+    }
+    return found;
+  }
+
+  // The most states any layer had.
+  size_t max_states() const { return max_states_; }
+
+  static std::string ToString(Count n) {
+    std::string s;
+    do {
+      s += static_cast<char>('0' + static_cast<int>(n % 10));
+      n /= 10;
+    } while (n);
+    return std::string(s.rbegin(), s.rend());
+  }
+
+ private:
+  typedef std::string State;
+
+  // Transition from the state before cell |from| to one after it; |choice|
+  // has bit 0 for the edge right of the cell and bit 1 for the one below.
+  struct Arc {
+    int from, to, choice;
+  };
+  struct Layer {
+    size_t states = 0;
+    std::vector<Arc> arcs;
+  };
+
+  // The original cell at row |i| and column |j| of the sweep.
+  int Original(int i, int j) const {
+    int original_width = transposed_ ? height_ : width_;
+    return transposed_ ? j * original_width + i : i * original_width + j;
+  }
+
+  bool Labelled(char v) const { return v > 0 && v <= pairs_; }
+
+  // Renumbers the fragment ids in order of first appearance.
+  void Canonicalize(State* s) const {
+    char map[128] = {0};
+    char next = pairs_ + 1;
+    for (auto& v : *s) {
+      if (v <= pairs_)
+        continue;
+      if (!map[static_cast<int>(v)])
+        map[static_cast<int>(v)] = next++;
+      v = map[static_cast<int>(v)];
+    }
+  }
+
+  // Gives the other loose end of fragment |id| the value |v|.
+  static void Replace(State* s, char id, char v) {
+    std::replace(s->begin(), s->end(), id, v);
+  }
+
+  // Calls |f| with each state that can follow |s| over cell |c|.
+  template <typename F>
+  void Step(int c, const State& s, F f) const {
+    int i = c / width_, j = c % width_;
+    char up = s[j], left = s[width_];
+    bool can_right = j + 1 < width_, can_down = i + 1 < height_;
+    int k = givens_[c];
+    State t = s;
+    t[j] = t[width_] = 0;
+
+    // Leaves with the fragment |v| going right or down.
+    auto leave = [&](char v) {
+      if (can_right) {
+        State r = t;
+        r[width_] = v;
+        f(r, 1);
+      }
+      if (can_down) {
+        State d = t;
+        d[j] = v;
+        f(d, 2);
+      }
+    };
+
+    if (k >= 0) {
+      char label = k + 1;
+      if (up && left)
+        return;
+      char v = up ? up : left;
+      if (!v) {
+        leave(label);
+      } else if (Labelled(v)) {
+        if (v == label)
+          f(t, 0);
+      } else {
+        Replace(&t, v, label);
+        f(t, 0);
+      }
+      return;
+    }
+
+    if (up && left) {
+      if (Labelled(up) && Labelled(left)) {
+        if (up == left)
+          f(t, 0);
+      } else if (Labelled(up) || Labelled(left)) {
+        Replace(&t, Labelled(up) ? left : up, Labelled(up) ? up : left);
+        f(t, 0);
+      } else if (up != left) {
+        Replace(&t, left, up);
+        f(t, 0);
+      }
+    } else if (up || left) {
+      leave(up ? up : left);
+    } else if (can_right && can_down) {
+      State n = t;
+      n[j] = n[width_] = static_cast<char>(pairs_ + 2 * width_ + 1);
+      f(n, 3);
+    }
+  }
+
+  // Converts per-cell choices of the sweep to edges of the original board.
+  void Edges(const std::vector<int>& choices, std::vector<char>* east_west,
+             std::vector<char>* north_south) const {
+    int width = transposed_ ? height_ : width_;
+    int height = transposed_ ? width_ : height_;
+    east_west->assign((width + 1) * height, false);
+    north_south->assign(width * (height + 1), false);
+    for (int i = 0; i < height_; ++i) {
+      for (int j = 0; j < width_; ++j) {
+        int choice = choices[i * width_ + j];
+        int o = Original(i, j), oi = o / width, oj = o % width;
+        // Right in the sweep is down on a transposed board.
+        bool right = choice & 1, down = choice & 2;
+        if (transposed_)
+          std::swap(right, down);
+        if (right)
+          (*east_west)[oi * (width + 1) + oj + 1] = true;
+        if (down)
+          (*north_south)[(oi + 1) * width + oj] = true;
+      }
+    }
+  }
+
+  bool transposed_;
+  int width_, height_, pairs_;
+  bool keep_arcs_;
+  std::vector<int> givens_;
+  std::vector<Layer> layers_;
+  int final_ = -1;
+  size_t max_states_ = 1;
+};
+
+#endif  // NUMBER_LINK_FRONTIER_H_
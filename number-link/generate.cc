@@ -0,0 +1,437 @@
+// Generates puzzles for scaling tests: random partitions of a board into a
+// given number of paths that fill it, with the ends of each path given.
+//
+// The rows are cut into short straight paths, which random moves from
+// their ends then merge down to the pairs and mix: an end takes over the
+// part of the neighbouring path from the cell next to it to one of that
+// path's ends, the whole of it while there are too many paths. Moves after
+// which a path would touch itself, running next to its own cells out of
+// turn, are refused, as the solver's uniqueness shortcuts rule such paths
+// out. Boards with too few pairs for that, or too few --mix moves per cell
+// to get there, have the rest merged regardless and count the touches in
+// their header. With --unique each puzzle is solved without the shortcuts
+// and kept only if blocking its solution leaves none; otherwise it is
+// drawn again.
+//
+// Puzzle i comes from its own generator seeded by (--seed, i), so the
+// output does not depend on the number of workers. Like bench, it is built
+// on number_link.h.
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <sstream>
+#include <thread>
+
+#include <sys/stat.h>
+
+#include "number_link.h"
+
+namespace {
+
+// The labels Instance::Parse() reads and a puzzle file can hold: digits
+// and letters first, then the other printable characters but '.', and '#',
+// which starts a comment line.
+std::string PuzzleLabels() {
+  std::string labels =
+      "123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0";
+  for (char c = '!'; c <= '~'; ++c) {
+    if (c != '.' && c != '#' && !std::isalnum(c))
+      labels += c;
+  }
+  return labels;
+}
+
+class PathPartition {
+ public:
+  // The fewest cells a path keeps.
+  static const size_t kMinLength = 3;
+
+  // Cuts each row into pieces of kMinLength to 2 * kMinLength - 1 cells, or
+  // each column on boards narrower than that. Straight pieces do not touch
+  // themselves.
+  PathPartition(int width, int height, std::mt19937_64* rng)
+      : width_(width), height_(height), rng_(*rng),
+        owner_(width * height), index_(width * height) {
+    bool rows = width >= static_cast<int>(kMinLength);
+    int lines = rows ? height : width, length = rows ? width : height;
+    std::uniform_int_distribution<int> piece(kMinLength, 2 * kMinLength - 1);
+    for (int i = 0; i < lines; ++i) {
+      for (int j = 0; j < length;) {
+        int n = piece(rng_);
+        if (length - j - n < static_cast<int>(kMinLength))
+          n = length - j;
+        paths_.emplace_back();
+        for (int k = j; k < j + n; ++k)
+          paths_.back().push_back(rows ? i * width + k : k * width + i);
+        Reindex(paths_.size() - 1, 0);
+        j += n;
+      }
+    }
+  }
+
+  // Makes |moves| attempts at a random move, which splits a path while
+  // there are fewer than |pairs| and may merge two while there are more.
+  // Unless |touching|, moves after which a path would touch itself are
+  // refused.
+  void Mix(int64_t moves, size_t pairs, bool touching) {
+    for (int64_t m = 0; m < moves; ++m)
+      Move(pairs, touching);
+  }
+
+  // Makes up to |moves| more attempts, letting paths touch themselves, to
+  // reach |pairs| paths. Returns whether it did.
+  bool Settle(int64_t moves, size_t pairs) {
+    for (int64_t m = 0; m < moves && paths_.size() != pairs; ++m)
+      Move(pairs, true);
+    return paths_.size() == pairs;
+  }
+
+  size_t size() const { return paths_.size(); }
+
+  // How many pairs of neighbouring cells lie on one path without following
+  // each other on it. The uniqueness shortcuts rule such paths out, so a
+  // puzzle with touches is only solved without them.
+  int64_t Touches() const {
+    int64_t adjacent = 0;
+    for (int c = 0; c < width_ * height_; ++c)
+      adjacent += Neighbours(c, owner_[c]);
+    // Each neighbouring pair is counted from both of its cells.
+    return adjacent / 2 - (width_ * height_ - static_cast<int64_t>(size()));
+  }
+
+  // The puzzle with the ends of path p labelled labels[p].
+  std::string Puzzle(const std::string& labels) const {
+    std::string text;
+    std::vector<std::string> rows(height_, std::string(width_, '.'));
+    for (size_t p = 0; p < paths_.size(); ++p) {
+      for (int c : {paths_[p].front(), paths_[p].back()})
+        rows[c / width_][c % width_] = labels[p];
+    }
+    for (auto& row : rows)
+      text += row + '\n';
+    return text;
+  }
+
+ private:
+  // Attaches to an end |a| of a path p the part of the path q next to it
+  // from its neighbour |b| to one end of q, if the rest of q keeps
+  // kMinLength cells or, while there are more than |pairs| paths, is empty.
+  // While there are fewer, splits p instead.
+  void Move(size_t pairs, bool touching) {
+    std::uniform_int_distribution<int> end(0, 2 * paths_.size() - 1);
+    int e = end(rng_);
+    int p = e / 2;
+    bool back = e % 2;
+    if (paths_.size() < pairs) {
+      Split(p);
+      return;
+    }
+    int a = back ? paths_[p].back() : paths_[p].front();
+    int b = RandomNeighbour(a);
+    if (b < 0 || owner_[b] == p)
+      return;
+    int q = owner_[b];
+    int i = index_[b], n = paths_[q].size();
+    bool tail = std::uniform_int_distribution<int>(0, 1)(rng_);
+    int begin = tail ? i : 0, stop = tail ? n : i + 1;
+    int rest = n - (stop - begin);
+    if (rest == 0 ? paths_.size() <= pairs
+                  : rest < static_cast<int>(kMinLength))
+      return;
+    // Only a and b may meet, or p would touch itself.
+    if (!touching) {
+      int contacts = 0;
+      for (int k = begin; k < stop && contacts <= 1; ++k)
+        contacts += Neighbours(paths_[q][k], p);
+      if (contacts > 1)
+        return;
+    }
+
+    auto& to = paths_[p];
+    if (!back) {
+      std::reverse(to.begin(), to.end());
+      Reindex(p, 0);
+    }
+    size_t size = to.size();
+    auto& from = paths_[q];
+    if (tail) {
+      to.insert(to.end(), from.begin() + begin, from.end());
+      from.erase(from.begin() + begin, from.end());
+    } else {
+      to.insert(to.end(), from.rend() - stop, from.rend());
+      from.erase(from.begin(), from.begin() + stop);
+      Reindex(q, 0);
+    }
+    Reindex(p, size);
+    if (rest == 0) {
+      std::swap(paths_[q], paths_.back());
+      paths_.pop_back();
+      if (q < static_cast<int>(paths_.size()))
+        Reindex(q, 0);
+    }
+  }
+
+  // Cuts path |p| in two at random, if both keep kMinLength cells.
+  void Split(int p) {
+    int n = paths_[p].size(), k = kMinLength;
+    if (n < 2 * k)
+      return;
+    int cut = std::uniform_int_distribution<int>(k, n - k)(rng_);
+    paths_.emplace_back(paths_[p].begin() + cut, paths_[p].end());
+    paths_[p].resize(cut);
+    Reindex(paths_.size() - 1, 0);
+  }
+
+  int RandomNeighbour(int c) {
+    int i = c / width_, j = c % width_;
+    int d = std::uniform_int_distribution<int>(0, 3)(rng_);
+    switch (d) {
+      case 0: return i > 0 ? c - width_ : -1;
+      case 1: return i + 1 < height_ ? c + width_ : -1;
+      case 2: return j > 0 ? c - 1 : -1;
+      default: return j + 1 < width_ ? c + 1 : -1;
+    }
+  }
+
+  // The neighbours of cell |c| on path |p|.
+  int Neighbours(int c, int p) const {
+    int i = c / width_, j = c % width_, n = 0;
+    n += i > 0 && owner_[c - width_] == p;
+    n += i + 1 < height_ && owner_[c + width_] == p;
+    n += j > 0 && owner_[c - 1] == p;
+    n += j + 1 < width_ && owner_[c + 1] == p;
+    return n;
+  }
+
+  // Updates owner_ and index_ for the cells of path |p| from |from| on.
+  void Reindex(int p, size_t from) {
+    auto& path = paths_[p];
+    for (size_t i = from; i < path.size(); ++i) {
+      owner_[path[i]] = p;
+      index_[path[i]] = i;
+    }
+  }
+
+  int width_, height_;
+  std::mt19937_64& rng_;
+  std::vector<std::vector<int>> paths_;
+  // The path of each cell and its position on it.
+  std::vector<int> owner_, index_;
+};
+
+struct GenerateOptions {
+  int width = 0, height = 0, pairs = 0;
+  int count = 1;
+  uint64_t seed = 1;
+  // Mixing moves per cell.
+  int mix = 20;
+  // Whether to let paths touch themselves from the start, rather than only
+  // when mixing does not reach the pairs without.
+  bool touching = false;
+  bool unique = false;
+  int attempts = 100;
+  int threads = 0;
+  // A directory to write each puzzle to, created if need be, or stdout if
+  // empty.
+  std::string out;
+};
+
+// Whether |text| has exactly one solution, searched without the shortcuts
+// that assume it.
+bool IsUnique(const std::string& text) {
+  Options options;
+  options.connectivity = Connectivity::Lazy;
+  std::istringstream in(text);
+  auto instance = Instance::read(in, options);
+  if (!SolveWithoutCycles(*instance))
+    return false;
+  instance->BlockSolution();
+  return !SolveWithoutCycles(*instance);
+}
+
+// Puzzle |index|, after up to options.attempts draws, and the touches left
+// in its paths. Returns false if no draw had the pairs or, with --unique,
+// was unique.
+bool Generate(const GenerateOptions& options, int index,
+              const std::string& labels, std::string* text,
+              int64_t* touches) {
+  std::seed_seq seeds{static_cast<uint32_t>(options.seed),
+                      static_cast<uint32_t>(options.seed >> 32),
+                      static_cast<uint32_t>(index)};
+  std::mt19937_64 rng(seeds);
+  int cells = options.width * options.height;
+  for (int attempt = 0; attempt < options.attempts; ++attempt) {
+    PathPartition partition(options.width, options.height, &rng);
+    int64_t moves = static_cast<int64_t>(options.mix) * cells;
+    partition.Mix(moves, options.pairs, options.touching);
+    if (!partition.Settle(moves, options.pairs))
+      continue;
+    *text = partition.Puzzle(labels);
+    *touches = partition.Touches();
+    if (!options.unique || (*touches == 0 && IsUnique(*text)))
+      return true;
+  }
+  return false;
+}
+
+void GenerateUsage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " --size=WxH --pairs=N [options]\n"
+            << "  --count=N                      "
+            << "number of puzzles (default 1)\n"
+            << "  --seed=S                       "
+            << "seed of the first puzzle's generator\n"
+            << "  --mix=M                        "
+            << "random moves per cell (default 20)\n"
+            << "  --touching                     "
+            << "let paths touch themselves, as they do anyway when\n"
+            << "                                 "
+            << "mixing does not reach N pairs without\n"
+            << "  --unique[=ATTEMPTS]            "
+            << "keep only puzzles with one solution\n"
+            << "  --threads=N                    "
+            << "generation workers (default: one per core)\n"
+            << "  --out=DIR                      "
+            << "write DIR/WxH-i.txt instead of stdout, creating DIR\n";
+}
+
+bool ParseGenerateOptions(int argc, char** argv, GenerateOptions* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&](const std::string& prefix, std::string* v) {
+      if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+      *v = arg.substr(prefix.size());
+      return true;
+    };
+
+    std::string v;
+    if (value("--size=", &v)) {
+      if (std::sscanf(v.c_str(), "%dx%d", &options->width,
+                      &options->height) != 2)
+        return false;
+    } else if (value("--pairs=", &v)) {
+      options->pairs = std::atoi(v.c_str());
+    } else if (value("--count=", &v)) {
+      options->count = std::atoi(v.c_str());
+    } else if (value("--seed=", &v)) {
+      options->seed = std::strtoull(v.c_str(), nullptr, 10);
+    } else if (value("--mix=", &v)) {
+      options->mix = std::atoi(v.c_str());
+    } else if (arg == "--touching") {
+      options->touching = true;
+    } else if (arg == "--unique") {
+      options->unique = true;
+    } else if (value("--unique=", &v)) {
+      options->unique = true;
+      options->attempts = std::atoi(v.c_str());
+    } else if (value("--threads=", &v)) {
+      options->threads = std::atoi(v.c_str());
+    } else if (value("--out=", &v)) {
+      options->out = v;
+    } else {
+      return false;
+    }
+  }
+  return options->width > 0 && options->height > 0 && options->pairs > 0 &&
+         options->count > 0 && options->attempts > 0;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  GenerateOptions options;
+  if (!ParseGenerateOptions(argc, argv, &options)) {
+    GenerateUsage(argv[0]);
+    return -1;
+  }
+  std::string labels = PuzzleLabels();
+  if (options.pairs > static_cast<int>(labels.size())) {
+    std::cerr << "at most " << labels.size() << " pairs have labels\n";
+    return -1;
+  }
+  int min_length = PathPartition::kMinLength;
+  if (std::max(options.width, options.height) < min_length ||
+      options.width * options.height < min_length * options.pairs) {
+    std::cerr << "the board is too small for " << options.pairs
+              << " pairs\n";
+    return -1;
+  }
+  if (!options.out.empty() && mkdir(options.out.c_str(), 0777) != 0 &&
+      errno != EEXIST) {
+    std::cerr << "Failed to create " << options.out << "\n";
+    return -1;
+  }
+
+  int threads = options.threads;
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  // As in SolveBatch(), puzzles are written in order as they are ready.
+  std::vector<std::string> results(options.count);
+  std::vector<int64_t> touches(options.count);
+  std::vector<char> ready(options.count), generated(options.count);
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<int> next(0);
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&]() {
+      for (int i; (i = next++) < options.count;) {
+        std::string text;
+        int64_t t = 0;
+        bool ok = Generate(options, i, labels, &text, &t);
+        std::lock_guard<std::mutex> lock(mutex);
+        results[i] = std::move(text);
+        touches[i] = t;
+        generated[i] = ok;
+        ready[i] = true;
+        cv.notify_all();
+      }
+    });
+  }
+
+  int failed = 0;
+  for (int i = 0; i < options.count; ++i) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return ready[i]; });
+    std::string text = std::move(results[i]);
+    lock.unlock();
+    if (!generated[i]) {
+      std::cerr << "puzzle " << i << ": no "
+                << (options.unique ? "unique draw" : "draw with all pairs")
+                << " in "
+                << options.attempts << " attempts\n";
+      ++failed;
+      continue;
+    }
+    std::ostringstream header;
+    header << "# " << options.width << "x" << options.height << " pairs "
+           << options.pairs << " seed " << options.seed << " index " << i
+           << (options.unique ? " unique" : "");
+    if (touches[i] > 0)
+      header << " touches " << touches[i];
+    header << "\n";
+    if (options.out.empty()) {
+      std::cout << (i ? "\n" : "") << header.str() << text;
+      continue;
+    }
+    std::string path = options.out + "/" + std::to_string(options.width) +
+                       "x" + std::to_string(options.height) + "-" +
+                       std::to_string(i) + ".txt";
+    std::ofstream file(path);
+    if (!(file << header.str() << text)) {
+      std::cerr << "Failed to write " << path << "\n";
+      ++failed;
+    }
+  }
+
+  for (auto& worker : workers)
+    worker.join();
+  return failed ? -1 : 0;
+}
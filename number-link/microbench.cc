@@ -0,0 +1,355 @@
+// Micro-benchmarks of the encoder primitives. Each emits into a NullSink,
+// which drops its clauses, and into a Minisat::Solver, so that what the
+// encoder itself costs shows apart from addClause(). Rows give clauses per
+// second and allocations per clause as (n, k) and the board grow. The
+// SetUp* families are timed as well, on templates of empty boards through
+// their PhaseStats.
+//
+// Like bench, it is built on number_link.h.
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <new>
+
+#include "number_link.h"
+
+// Every allocation the process makes. Where glibc lets the C allocator be
+// interposed, that also catches the realloc() in Minisat::vec; elsewhere
+// only operator new is counted.
+static int64_t g_allocations = 0;
+
+#ifdef __GLIBC__
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* p, size_t size);
+void __libc_free(void* p);
+
+void* malloc(size_t size) {
+  ++g_allocations;
+  return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size) {
+  ++g_allocations;
+  return __libc_calloc(count, size);
+}
+
+void* realloc(void* p, size_t size) {
+  ++g_allocations;
+  return __libc_realloc(p, size);
+}
+
+void free(void* p) { __libc_free(p); }
+}
+#else
+void* operator new(size_t size) {
+  ++g_allocations;
+  if (void* p = std::malloc(size))
+    return p;
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+#endif
+
+namespace {
+
+// A sink that drops its clauses, but only after reading their literals,
+// so that the compiler cannot drop the encoding as well.
+struct NullSink {
+  int vars = 0;
+  uint64_t checksum = 0;
+
+  Minisat::Var newVar() { return vars++; }
+
+  bool addClause(const Minisat::vec<Minisat::Lit>& ps) {
+    for (int i = 0; i < ps.size(); ++i)
+      Read(ps[i]);
+    return true;
+  }
+
+  template <typename... Lits>
+  bool addClause(const Lits&... ps) {
+    int unused[] = {(Read(ps), 0)...};
+    (void)unused;
+    return true;
+  }
+
+ private:
+  void Read(const Minisat::Lit& p) {
+    checksum = checksum * 31 + Minisat::toInt(p);
+  }
+};
+
+// Keeps |checksum| observable.
+volatile uint64_t g_checksum;
+
+struct Result {
+  std::string primitive, shape, sink;
+  int64_t clauses = 0, allocations = -1;
+  double ms = 0;
+};
+
+uint64_t Checksum(const NullSink& sink) { return sink.checksum; }
+uint64_t Checksum(const Minisat::Solver& solver) { return solver.nClauses(); }
+
+// Runs |emit| over |vars| variables of a fresh sink, twice as many times
+// as before until that takes |min_ms|, and measures the last such round.
+// Setting up and tearing down the sink is left out.
+template <typename Solver, typename Emit>
+Result Repeat(const char* name, int vars, Emit& emit, double min_ms) {
+  Result result;
+  result.sink = name;
+  for (int64_t rounds = 1;; rounds *= 2) {
+    Solver solver;
+    CountingSink<Solver> sink(solver);
+    std::vector<Minisat::Lit> xs;
+    for (int v = 0; v < vars; ++v)
+      xs.push_back(Minisat::mkLit(solver.newVar()));
+    int64_t allocations = g_allocations;
+    auto start = std::chrono::steady_clock::now();
+    for (int64_t r = 0; r < rounds; ++r)
+      emit(sink, xs);
+    result.ms = MillisecondsSince(start);
+    result.allocations = g_allocations - allocations;
+    result.clauses = sink.clauses;
+    g_checksum = Checksum(solver);
+    if (result.ms >= min_ms)
+      return result;
+  }
+}
+
+class Suite {
+ public:
+  explicit Suite(double min_ms) : min_ms_(min_ms) {}
+
+  // Runs |emit|, a generic (sink, literals) callback, on both sinks.
+  template <typename Emit>
+  void Both(const std::string& primitive, const std::string& shape, int vars,
+            Emit emit) {
+    Add(primitive, shape, Repeat<NullSink>("null", vars, emit, min_ms_));
+    Add(primitive, shape,
+        Repeat<Minisat::Solver>("minisat", vars, emit, min_ms_));
+  }
+
+  template <typename Emit>
+  void Null(const std::string& primitive, const std::string& shape, int vars,
+            Emit emit) {
+    Add(primitive, shape, Repeat<NullSink>("null", vars, emit, min_ms_));
+  }
+
+  void Add(const std::string& primitive, const std::string& shape,
+           Result result) {
+    result.primitive = primitive;
+    result.shape = shape;
+    results_.push_back(result);
+  }
+
+  const std::vector<Result>& results() const { return results_; }
+
+ private:
+  double min_ms_;
+  std::vector<Result> results_;
+};
+
+std::string Shape(int a, int b, const char* separator) {
+  return std::to_string(a) + separator + std::to_string(b);
+}
+
+// Calls |f| with the cells on both sides of each inner edge of a |size| by
+// |size| board, and the edge's index.
+template <typename F>
+void ForEachLink(int size, F f) {
+  int e = 0;
+  for (int i = 0; i < size; ++i) {
+    for (int j = 0; j < size; ++j) {
+      if (i > 0)
+        f(e++, (i - 1) * size + j, i * size + j);
+      if (j > 0)
+        f(e++, i * size + j - 1, i * size + j);
+    }
+  }
+}
+
+void Primitives(Suite* suite) {
+  const int shapes[][2] = {{4, 1}, {4, 2}, {8, 1}, {8, 2}, {12, 1},
+                           {12, 2}, {16, 1}, {16, 3}};
+  for (auto& shape : shapes) {
+    int n = shape[0], k = shape[1];
+    suite->Null("choose", Shape(n, k, ","), n, [&](auto& sink,
+                                                  const auto& xs) {
+      std::vector<Minisat::Lit> chosen;
+      Choose(k, xs.begin(), xs.end(), chosen, [&]() { ++sink.clauses; });
+    });
+    for (auto c : {Cardinality::Binomial, Cardinality::Sequential,
+                   Cardinality::Totalizer, Cardinality::Commander,
+                   Cardinality::Product}) {
+      if (ResolveCardinality(c, n, k) != c)
+        continue;
+      suite->Both(std::string("exact/") + CardinalityName(c),
+                  Shape(n, k, ","), n, [&](auto& sink, const auto& xs) {
+        Exact(sink, k, xs, c);
+      });
+    }
+  }
+
+  // Glue and Stick over each edge and label, and the two corner clauses
+  // per turn, as the one-hot encoding of an empty board with as many
+  // labels as columns lays them out: the edges, the labels by cell, then
+  // the sinks.
+  for (int size : {5, 10, 20, 40}) {
+    int pairs = size, cells = size * size, edges = 2 * size * (size - 1);
+    int vars = edges + cells * pairs + cells;
+    auto label = [=](const std::vector<Minisat::Lit>& xs, int c, int k) {
+      return xs[edges + c * pairs + k];
+    };
+    std::string board = Shape(size, size, "x");
+    suite->Both("glue", board, vars, [&](auto& sink, const auto& xs) {
+      ForEachLink(size, [&](int e, int c, int d) {
+        for (int k = 0; k < pairs; ++k)
+          Glue(sink, xs[e], label(xs, c, k), label(xs, d, k));
+      });
+    });
+    suite->Both("stick", board, vars, [&](auto& sink, const auto& xs) {
+      ForEachLink(size, [&](int e, int c, int d) {
+        for (int k = 0; k < pairs; ++k)
+          Stick(sink, xs[e], label(xs, c, k), label(xs, d, k));
+      });
+    });
+    // Each turn at a cell, as SetUpCornerPropagationConstraints() walks
+    // them, where the diagonal cell has both edges too; on the border the
+    // encoder folds the missing ones into constants.
+    std::vector<int> north(cells, -1), west(cells, -1);
+    ForEachLink(size, [&](int e, int c, int d) {
+      (d == c + 1 ? west : north)[d] = e;
+    });
+    // The edge of cell (i, j) towards |di| rows and |dj| columns.
+    auto edge = [&](int i, int j, int di, int dj) {
+      int c = i * size + j;
+      if (di)
+        return di < 0 ? north[c] : i + 1 < size ? north[c + size] : -1;
+      return dj < 0 ? west[c] : j + 1 < size ? west[c + 1] : -1;
+    };
+    suite->Both("corner", board, vars, [&](auto& sink, const auto& xs) {
+      int sinks = edges + cells * pairs;
+      for (int i = 0; i < size; ++i) {
+        for (int j = 0; j < size; ++j) {
+          for (int di : {-1, 1}) {
+            for (int dj : {-1, 1}) {
+              int ii = i + di, jj = j + dj;
+              if (ii < 0 || ii >= size || jj < 0 || jj >= size)
+                continue;
+              int e = edge(i, j, di, 0), f = edge(i, j, 0, dj);
+              int x = edge(ii, jj, di, 0), y = edge(ii, jj, 0, dj);
+              if (x < 0 || y < 0)
+                continue;
+              Corner(sink, xs[e], xs[f], xs[sinks + ii * size + jj], xs[x],
+                     xs[y]);
+            }
+          }
+        }
+      }
+    });
+  }
+}
+
+// The SetUp* families of Instance on templates of empty boards, through
+// its PhaseStats. They only emit into SimpSolver, and allocations are not
+// split by family.
+void Families(const Options& base, Suite* suite) {
+  Options options = base;
+  options.stats = true;
+  for (int size : {5, 10, 20, 40}) {
+    auto instance = Instance::Template(options, size, size, size);
+    for (auto& phase : instance->phases.phases()) {
+      if (phase.name == "variables" || phase.clauses <= 0)
+        continue;
+      Result result;
+      result.sink = "simp";
+      result.clauses = phase.clauses + phase.units;
+      result.ms = phase.ms;
+      suite->Add("family/" + phase.name, Shape(size, size, "x"), result);
+    }
+  }
+}
+
+void MicroUsage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " [options]\n"
+            << "  --min-time=MS                  "
+            << "emit each row for at least MS ms (default 200)\n"
+            << "  --json=PATH                    "
+            << "also write a JSON line per row\n"
+            << "and the encoding options of main, for the families.\n";
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  double min_ms = 200;
+  std::string json_path;
+  std::vector<char*> rest(1, argv[0]);
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.compare(0, 11, "--min-time=") == 0)
+      min_ms = std::atof(arg.c_str() + 11);
+    else if (arg.compare(0, 7, "--json=") == 0)
+      json_path = arg.substr(7);
+    else
+      rest.push_back(argv[i]);
+  }
+  Options options;
+  if (!ParseOptions(rest.size(), rest.data(), &options)) {
+    MicroUsage(argv[0]);
+    return -1;
+  }
+  if (!Instance::HasTemplate(options)) {
+    std::cerr << "the families need --engine=labels without distance "
+              << "connectivity\n";
+    return -1;
+  }
+
+  Suite suite(min_ms);
+  Primitives(&suite);
+  Families(options, &suite);
+
+  std::ofstream json;
+  if (!json_path.empty()) {
+    json.open(json_path);
+    if (!json) {
+      std::cerr << "Failed to open " << json_path << "\n";
+      return -1;
+    }
+  }
+  std::cout << std::left << std::setw(22) << "primitive" << std::setw(8)
+            << "shape" << std::setw(8) << "sink" << std::right
+            << std::setw(12) << "clauses" << std::setw(14) << "clauses/s"
+            << std::setw(15) << "allocs/clause" << "\n";
+  for (auto& r : suite.results()) {
+    double per_second = r.ms > 0 ? r.clauses / r.ms * 1000 : 0;
+    std::cout << std::left << std::setw(22) << r.primitive << std::setw(8)
+              << r.shape << std::setw(8) << r.sink << std::right
+              << std::setw(12) << r.clauses << std::setw(14)
+              << static_cast<int64_t>(per_second) << std::setw(15);
+    if (r.allocations < 0)
+      std::cout << "-";
+    else
+      std::cout << std::fixed << std::setprecision(3)
+                << static_cast<double>(r.allocations) /
+                       std::max<int64_t>(r.clauses, 1)
+                << std::defaultfloat;
+    std::cout << "\n";
+    if (!json_path.empty()) {
+      json << "{\"primitive\":" << JsonString(r.primitive)
+           << ",\"shape\":" << JsonString(r.shape)
+           << ",\"sink\":" << JsonString(r.sink)
+           << ",\"clauses\":" << r.clauses << ",\"ms\":" << r.ms
+           << ",\"clauses_per_second\":" << per_second;
+      if (r.allocations >= 0)
+        json << ",\"allocations\":" << r.allocations;
+      json << "}\n";
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,1455 @@
+#include "number_link.h"
+
+#include <atomic>
+#include <cctype>
+#include <cerrno>
+#include <climits>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <fstream>
+#include <iomanip>
+#include <iterator>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "backend.h"
+#include "cdcl.h"
+#include "clause_exchange.h"
+#include "connectivity.h"
+#include "frontier.h"
+
+double MillisecondsSince(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double, std::milli>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+bool IsLazy(const Options& options) {
+  return options.connectivity == Connectivity::Lazy ||
+         options.engine == Engine::Edges;
+}
+
+const char* NoSolution(const Options& options) {
+  bool shortcuts = options.connectivity == Connectivity::Spanning &&
+                   (options.engine == Engine::Labels ||
+                    options.engine == Engine::Bitboard);
+  return shortcuts ? "No unique spanning solution." : "No solution.";
+}
+
+// Cuts every closed loop of the last model out of |instance|, and with the
+// edges engine every path joining two different labels, returning whether
+// there were any.
+template <typename Solver>
+bool RefineModel(BasicInstance<Solver>& instance) {
+  Phase<Solver> phase(instance.phases, "refine", instance.solver);
+  auto start = std::chrono::steady_clock::now();
+  bool refined = false;
+  if (instance.edges_only()) {
+    for (auto& path : instance.Paths()) {
+      if (instance.givens[path.front()] != instance.givens[path.back()]) {
+        instance.CutPath(path);
+        refined = true;
+      }
+    }
+  }
+  for (auto& cycle : instance.Cycles()) {
+    instance.CutCycle(cycle);
+    refined = true;
+  }
+  instance.refinement.refine_ms += MillisecondsSince(start);
+  return refined;
+}
+
+template <typename Solver>
+bool SolveWithoutCycles(BasicInstance<Solver>& instance,
+                        const std::vector<Minisat::Lit>& assumptions) {
+  Phase<Solver> phase(instance.phases, "solve", instance.solver);
+  instance.last_deduced = instance.deduced_model;
+  if (instance.deduced_model) {
+    instance.deduced_model = false;
+    return true;
+  }
+  for (;;) {
+    for (auto& x : assumptions)
+      instance.solver.assume(x);
+    if (!instance.solver.solve())
+      return false;
+    ++instance.refinement.rounds;
+    if (!RefineModel(instance))
+      return true;
+  }
+}
+
+template <typename Solver>
+bool SolveWithoutCycles(BasicInstance<Solver>& instance) {
+  return SolveWithoutCycles(instance, std::vector<Minisat::Lit>());
+}
+
+template bool SolveWithoutCycles(Instance&, const std::vector<Minisat::Lit>&);
+template bool SolveWithoutCycles(Instance&);
+
+// Adds the search counters of the solver of |instance| to its PhaseStats,
+// where its backend reports them.
+template <typename Solver>
+void CountSearch(BasicInstance<Solver>& instance) {
+  auto stats = instance.solver.stats();
+  if (stats.conflicts < 0)
+    return;
+  instance.phases.Count("conflicts", stats.conflicts);
+  instance.phases.Count("decisions", stats.decisions);
+  instance.phases.Count("propagations", stats.propagations);
+}
+
+void CountSearch(Instance& instance) {
+  auto& solver = instance.solver.solver();
+  instance.phases.Count("conflicts", solver.conflicts);
+  instance.phases.Count("decisions", solver.decisions);
+  instance.phases.Count("propagations", solver.propagations);
+  instance.phases.Count("restarts", solver.starts);
+}
+
+bool WriteStats(const PhaseStats& phases, const Options& options) {
+  if (!options.stats)
+    return true;
+  if (options.stats_file.empty()) {
+    phases.Json(std::cerr);
+    std::cerr << '\n';
+    return true;
+  }
+  std::ofstream out(options.stats_file);
+  phases.Json(out);
+  out << '\n';
+  out.close();
+  if (!out) {
+    std::cerr << "Failed to write " << options.stats_file << "\n";
+    return false;
+  }
+  return true;
+}
+
+// The ConnectivityPropagator over the one-hot labels and edges of
+// |instance| and the endpoints of its givens.
+void Connect(BasicInstance<CdclBackend<ConnectivityPropagator>>& instance) {
+  int pairs = instance.pairs, width = instance.width;
+  std::vector<Minisat::Lit> assignments(width * instance.height * pairs,
+                                        kFalse);
+  std::vector<std::vector<int>> endpoints(pairs);
+  for (int i = 0; i < instance.height; ++i) {
+    for (int j = 0; j < width; ++j) {
+      int c = i * width + j;
+      instance.ForEachAssignment(i, j, [&](int k, const Minisat::Lit& x) {
+        assignments[c * pairs + k] = x;
+      });
+      if (instance.givens[c] >= 0)
+        endpoints[instance.givens[c]].push_back(c);
+    }
+  }
+  instance.solver.SetPropagator(ConnectivityPropagator(
+      width, instance.height, pairs, std::move(assignments),
+      instance.east_west, instance.north_south, endpoints));
+}
+
+// The name of a backend in reports.
+const char* BackendName(const SharingBackend&) { return "minisat"; }
+
+const char* BackendName(const CdclBackend<ConnectivityPropagator>&) {
+  return "cdcl+connectivity";
+}
+
+const char* BackendName(const CdclBackend<NoPropagator>&) { return "cdcl"; }
+
+#ifdef NUMBER_LINK_HAVE_IPASIR
+const char* BackendName(const IpasirBackend&) {
+  return IpasirBackend::signature();
+}
+#endif
+
+// Calls |f| with a null pointer to the backend |backend| names, other than
+// Compare, for |f| to take the type from.
+template <typename F>
+auto WithBackend(Backend backend, F f)
+    -> decltype(f(static_cast<SharingBackend*>(nullptr))) {
+  switch (backend) {
+    case Backend::Cdcl:
+      return f(static_cast<CdclBackend<ConnectivityPropagator>*>(nullptr));
+#ifdef NUMBER_LINK_HAVE_IPASIR
+    case Backend::Ipasir:
+      return f(static_cast<IpasirBackend*>(nullptr));
+#endif
+    default:
+      return f(static_cast<SharingBackend*>(nullptr));
+  }
+}
+
+// Prints the search counters of a backend as Minisat's printStats() does,
+// where it reports them.
+void PrintCounters(const BackendStats& stats) {
+  if (stats.conflicts < 0)
+    return;
+  std::cout << "conflicts             : " << stats.conflicts << '\n'
+            << "decisions             : " << stats.decisions << '\n'
+            << "propagations          : " << stats.propagations << '\n';
+}
+
+template <typename Solver>
+void PrintSearch(const Solver& solver) {
+  PrintCounters(solver.stats());
+}
+
+void PrintSearch(const SharingBackend& backend) {
+  backend.solver().printStats();
+}
+
+// Reports on stderr what the propagator of a CdclBackend did.
+template <typename Propagator>
+void ReportPropagator(const CdclBackend<Propagator>& backend) {
+  auto& stats = backend.solver().stats();
+  std::cerr << "cdcl: " << stats.theory_calls << " propagator calls, "
+            << stats.theory_propagations << " propagations and "
+            << stats.theory_conflicts << " conflicts explained\n";
+}
+
+template <typename Propagator>
+void PrintSearch(const CdclBackend<Propagator>& backend) {
+  PrintCounters(backend.stats());
+  ReportPropagator(backend);
+}
+
+// Draws a solution of |board| from whether each edge is on, by its position
+// in Instance's |east_west| and |north_south|.
+template <typename F, typename G>
+void RenderEdges(std::ostream& out, const Board& board, F east_west,
+                 G north_south) {
+  int width = board.width;
+  Instance::Render(
+      out, board.labels, width, board.height,
+      [&](int i, int j, Instance::Direction d) -> bool {
+        switch (d) {
+          case Instance::Sink: return board.givens[i * width + j] >= 0;
+          case Instance::East: return east_west(i * (width + 1) + j + 1);
+          case Instance::West: return east_west(i * (width + 1) + j);
+          case Instance::North: return north_south(i * width + j);
+          case Instance::South: return north_south((i + 1) * width + j);
+        }
+        return false;
+      },
+      [&](int i, int j) { return board.givens[i * width + j]; });
+}
+
+bool SolveBitboard(const Board& board, const Options& options,
+                   BitboardSolver::Stats* stats, std::ostream& out) {
+  BitboardSolver solver(board.width, board.height, board.pairs, board.givens,
+                        options.connectivity == Connectivity::Spanning);
+  bool solved = solver.Solve();
+  *stats = solver.stats();
+  if (solved) {
+    RenderEdges(out, board,
+                [&](int p) { return solver.east_west(p); },
+                [&](int p) { return solver.north_south(p); });
+  }
+  return solved;
+}
+
+// Draws up to |limit| solutions (all if 0) of |board| counted by |counter|
+// to |out|, but for the first |skip| of them, each followed by a blank line
+// if |separate|. Returns how many it went through, skipped or drawn.
+int64_t RenderFrontier(const FrontierCounter& counter, const Board& board,
+                       int64_t limit, bool separate, std::ostream& out,
+                       int64_t skip = 0) {
+  return counter.Enumerate(
+      limit, [&](const std::vector<char>& east_west,
+                 const std::vector<char>& north_south) {
+        if (skip > 0) {
+          --skip;
+          return;
+        }
+        RenderEdges(out, board, [&](int p) { return east_west[p] != 0; },
+                    [&](int p) { return north_south[p] != 0; });
+        if (separate)
+          out << std::endl;
+      });
+}
+
+// Splits |in| into puzzles separated by blank lines. They are named after
+// |source|, with "#n" appended if there are several.
+void SplitPuzzles(std::istream& in, const std::string& source,
+                  std::vector<Puzzle>* puzzles) {
+  size_t first = puzzles->size();
+  std::string line, text;
+  auto flush = [&]() {
+    if (!text.empty())
+      puzzles->push_back(Puzzle{source, text});
+    text.clear();
+  };
+  while (std::getline(in, line)) {
+    if (line.empty()) {
+      flush();
+      continue;
+    }
+    text += line;
+    text += '\n';
+  }
+  flush();
+
+  if (puzzles->size() - first > 1) {
+    for (size_t i = first; i < puzzles->size(); ++i)
+      (*puzzles)[i].name += "#" + std::to_string(i - first + 1);
+  }
+}
+
+bool LoadPuzzles(const std::string& path, std::vector<Puzzle>* puzzles) {
+  if (path == "-") {
+    SplitPuzzles(std::cin, "stdin", puzzles);
+    return true;
+  }
+
+  if (path[0] == '@') {
+    std::ifstream list(path.substr(1));
+    if (!list)
+      return false;
+    std::string file;
+    while (std::getline(list, file)) {
+      if (!file.empty() && file[0] != '#' && !LoadPuzzles(file, puzzles))
+        return false;
+    }
+    return true;
+  }
+
+  struct stat st;
+  if (stat(path.c_str(), &st) != 0)
+    return false;
+  if (S_ISDIR(st.st_mode)) {
+    DIR* dir = opendir(path.c_str());
+    if (!dir)
+      return false;
+    std::vector<std::string> files;
+    while (dirent* entry = readdir(dir)) {
+      if (entry->d_name[0] != '.')
+        files.push_back(path + "/" + entry->d_name);
+    }
+    closedir(dir);
+    std::sort(files.begin(), files.end());
+    for (auto& file : files) {
+      if (!LoadPuzzles(file, puzzles))
+        return false;
+    }
+    return true;
+  }
+
+  std::ifstream in(path);
+  if (!in)
+    return false;
+  SplitPuzzles(in, path, puzzles);
+  return true;
+}
+
+std::string JsonString(const std::string& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    switch (c) {
+      case '"': out += "\\\""; break;
+      case '\\': out += "\\\\"; break;
+      case '\n': out += "\\n"; break;
+      default:
+        if (static_cast<unsigned char>(c) < 0x20) {
+          char buf[8];
+          snprintf(buf, sizeof(buf), "\\u%04x", c);
+          out += buf;
+        } else {
+          out += c;
+        }
+    }
+  }
+  return out + "\"";
+}
+
+// The lines of |text| as a JSON array of strings.
+std::string JsonLines(const std::string& text) {
+  std::istringstream lines(text);
+  std::string json = "[", line;
+  for (int i = 0; std::getline(lines, line); ++i)
+    json += (i ? "," : "") + JsonString(line);
+  return json + "]";
+}
+
+bool IsRectangular(const std::string& text) {
+  size_t width = 0;
+  std::istringstream rows(text);
+  std::string row;
+  while (std::getline(rows, row)) {
+    if (row.empty() || row[0] == '#')
+      continue;
+    if (width && row.size() != width)
+      return false;
+    width = row.size();
+  }
+  return true;
+}
+
+// Templates by (width, height, pairs), owned by one batch worker.
+template <typename Solver>
+using TemplateCache =
+    std::map<std::tuple<int, int, int>,
+             std::unique_ptr<BasicInstance<Solver>>>;
+
+// Solves one puzzle and describes it as a JSON line. The puzzle gets a fresh
+// instance, or the template for its shape in |templates| if given.
+template <typename Solver>
+std::string SolvePuzzle(const Puzzle& puzzle, size_t index,
+                        const Options& options,
+                        TemplateCache<Solver>* templates) {
+  std::ostringstream json;
+  json << "{\"index\":" << index << ",\"name\":" << JsonString(puzzle.name);
+
+  if (!IsRectangular(puzzle.text)) {
+    json << ",\"status\":\"error\",\"error\":\"ragged rows\"}";
+    return json.str();
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  std::istringstream in(puzzle.text);
+  if (options.engine == Engine::Bitboard) {
+    auto board = Instance::Parse(in);
+    if (board.width <= BitboardSolver::kMaxWidth) {
+      BitboardSolver::Stats stats;
+      std::ostringstream out;
+      bool solved = SolveBitboard(board, options, &stats, out);
+      json << ",\"width\":" << board.width
+           << ",\"height\":" << board.height
+           << ",\"pairs\":" << board.pairs
+           << ",\"status\":\"" << (solved ? "solved" : "unsolvable") << "\""
+           << ",\"nodes\":" << stats.nodes
+           << ",\"table_hits\":" << stats.table_hits
+           << ",\"solve_ms\":" << MillisecondsSince(start);
+      if (solved)
+        json << ",\"solution\":" << JsonLines(out.str());
+      json << "}";
+      return json.str();
+    }
+    in.clear();
+    in.seekg(0);
+  }
+  if (options.engine == Engine::Frontier) {
+    auto board = Instance::Parse(in);
+    FrontierCounter counter(board.width, board.height, board.pairs,
+                            board.givens, true);
+    json << ",\"width\":" << board.width
+         << ",\"height\":" << board.height
+         << ",\"pairs\":" << board.pairs;
+    if (!counter.supported()) {
+      json << ",\"status\":\"error\",\"error\":\"too many labels\"}";
+      return json.str();
+    }
+    auto count = counter.Run();
+    std::ostringstream out;
+    RenderFrontier(counter, board, 1, false, out);
+    json << ",\"status\":\"" << (count ? "solved" : "unsolvable") << "\""
+         << ",\"solutions\":" << FrontierCounter::ToString(count)
+         << ",\"states\":" << counter.max_states()
+         << ",\"solve_ms\":" << MillisecondsSince(start);
+    if (count)
+      json << ",\"solution\":" << JsonLines(out.str());
+    json << "}";
+    return json.str();
+  }
+  std::unique_ptr<BasicInstance<Solver>> built;
+  BasicInstance<Solver>* instance;
+  std::vector<Minisat::Lit> assumptions;
+  bool cached = false;
+  bool refuted = false;
+  if (templates) {
+    auto board = Instance::Parse(in);
+    auto& slot = (*templates)[std::make_tuple(board.width, board.height,
+                                              board.pairs)];
+    cached = slot != nullptr;
+    if (!cached)
+      slot = BasicInstance<Solver>::Template(options, board.pairs,
+                                             board.width, board.height);
+    instance = slot.get();
+    refuted = !instance->Assume(board, &assumptions);
+  } else {
+    built = BasicInstance<Solver>::read(in, options);
+    instance = built.get();
+  }
+  double encode_ms = MillisecondsSince(start);
+  auto& solver = instance->solver;
+  int vars = solver.nVars();
+  int clauses = solver.nClauses();
+  auto before = solver.stats();
+  start = std::chrono::steady_clock::now();
+  bool solved = !refuted && SolveWithoutCycles(*instance, assumptions);
+  double solve_ms = MillisecondsSince(start);
+  auto stats = solver.stats().Since(before);
+
+  json << ",\"width\":" << instance->width
+       << ",\"height\":" << instance->height
+       << ",\"pairs\":" << instance->pairs
+       << ",\"status\":\"" << (solved ? "solved" : "unsolvable") << "\""
+       << ",\"backend\":" << JsonString(BackendName(solver))
+       << ",\"variables\":" << vars
+       << ",\"clauses\":" << clauses;
+  // Backends that do not count leave the counters out.
+  if (stats.conflicts >= 0) {
+    json << ",\"conflicts\":" << stats.conflicts
+         << ",\"decisions\":" << stats.decisions
+         << ",\"propagations\":" << stats.propagations;
+  }
+  json << ",\"encode_ms\":" << encode_ms
+       << ",\"solve_ms\":" << solve_ms;
+  if (templates)
+    json << ",\"template\":\"" << (cached ? "hit" : "miss") << "\"";
+  if (options.deduce) {
+    json << ",\"deduced\":" << instance->deduction.fixed
+         << ",\"edges\":" << instance->deduction.edges
+         << ",\"search\":"
+         << (instance->deduction.complete ? "false" : "true");
+  }
+  if (instance->simplification.ran) {
+    json << ",\"eliminated\":" << instance->simplification.eliminated
+         << ",\"simplify_ms\":" << instance->simplification.simplify_ms;
+  }
+  if (options.stats) {
+    json << ",\"stats\":";
+    instance->phases.Json(json);
+    instance->phases.Clear();
+  }
+  if (IsLazy(options)) {
+    json << ",\"rounds\":" << instance->refinement.rounds
+         << ",\"cuts\":" << instance->refinement.cuts
+         << ",\"refine_ms\":" << instance->refinement.refine_ms;
+  }
+  if (solved) {
+    std::ostringstream out;
+    instance->show(out);
+    json << ",\"solution\":" << JsonLines(out.str());
+  }
+  json << "}";
+  return json.str();
+}
+
+// Solves |puzzles| on |threads| workers, each building its own instances on
+// |Solver| or keeping its own templates, and writes their JSON lines to
+// |out| in input order as they become available. Returns the wall time in
+// seconds.
+template <typename Solver>
+double SolveBatch(const std::vector<Puzzle>& puzzles, const Options& options,
+                  int threads, std::ostream* out) {
+  std::vector<std::string> results(puzzles.size());
+  std::vector<char> ready(puzzles.size());
+  std::mutex mutex;
+  std::condition_variable cv;
+  std::atomic<size_t> next(0);
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&]() {
+      TemplateCache<Solver> templates;
+      for (size_t i; (i = next++) < puzzles.size();) {
+        auto result = SolvePuzzle(puzzles[i], i, options,
+                                  options.templates ? &templates : nullptr);
+        std::lock_guard<std::mutex> lock(mutex);
+        results[i] = std::move(result);
+        ready[i] = true;
+        cv.notify_all();
+      }
+    });
+  }
+
+  for (size_t i = 0; i < puzzles.size(); ++i) {
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [&]() { return ready[i]; });
+    std::string result = std::move(results[i]);
+    lock.unlock();
+    if (out)
+      *out << result << std::endl;
+  }
+
+  for (auto& worker : workers)
+    worker.join();
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+int RunBatch(Options options) {
+  if (options.templates && !Instance::HasTemplate(options)) {
+    std::cerr << "templates need --engine=labels without distance "
+              << "connectivity; building each puzzle instead\n";
+    options.templates = false;
+  }
+  if (options.templates && options.backend == Backend::Cdcl) {
+    std::cerr << "templates: the connectivity propagator learns clauses "
+              << "that hold for one puzzle's givens; building each puzzle "
+              << "instead\n";
+    options.templates = false;
+  }
+
+  std::vector<Puzzle> puzzles;
+  for (auto& path : options.batch) {
+    if (!LoadPuzzles(path, &puzzles)) {
+      std::cerr << "Failed to load " << path << "\n";
+      return -1;
+    }
+  }
+
+  int threads = options.threads;
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  std::vector<int> counts;
+  if (options.scaling) {
+    for (int t = 1; t < threads; t *= 2)
+      counts.push_back(t);
+  }
+  counts.push_back(threads);
+
+  for (int t : counts) {
+    bool last = t == counts.back();
+    double seconds = WithBackend(options.backend, [&](auto* backend) {
+      typedef std::remove_pointer_t<decltype(backend)> Solver;
+      return SolveBatch<Solver>(puzzles, options, t,
+                                last ? &std::cout : nullptr);
+    });
+    std::cerr << "batch: " << puzzles.size() << " puzzles, " << t
+              << " threads, " << seconds << " s, "
+              << puzzles.size() / seconds << " puzzles/s\n";
+  }
+  return 0;
+}
+
+// Solver settings and encoding of one portfolio thread. Threads in the same
+// |group| build identical CNFs, so they can exchange learnt clauses.
+struct PortfolioConfig {
+  Options options;
+  int group;
+  std::string name;
+  double random_seed;
+  double random_var_freq;
+  bool luby_restart;
+  int restart_first;
+  int phase_saving;
+  bool rnd_pol;
+  int ccmin_mode;
+};
+
+PortfolioConfig Diversify(const Options& base, int w) {
+  PortfolioConfig config;
+  config.options = base;
+  config.group = 0;
+  config.name = "base";
+  switch (w % 4) {
+    case 2:
+      config.options.assignment_cardinality = Cardinality::Product;
+      config.group = 1;
+      config.name = "product";
+      break;
+    case 3:
+      config.options.label_encoding = LabelEncoding::Binary;
+      config.group = 2;
+      config.name = "binary";
+      break;
+  }
+
+  // Thread 0 keeps MiniSat's defaults; the others move away from them.
+  config.random_seed = 91648253 + 7919 * w;
+  config.random_var_freq = w == 0 ? 0 : 0.005 * (w % 3);
+  config.luby_restart = w % 2 == 0;
+  config.restart_first = w == 0 ? 100 : 50 << (w % 3);
+  config.phase_saving = w == 0 ? 2 : 2 - (w / 2) % 3;
+  config.rnd_pol = w % 8 == 7;
+  config.ccmin_mode = w % 5 == 4 ? 1 : 2;
+  config.name += " seed=" + std::to_string(w) +
+                 (config.luby_restart ? " luby" : " geometric") +
+                 " phase=" + std::to_string(config.phase_saving);
+  return config;
+}
+
+struct PortfolioResult {
+  int winner = -1;
+  bool solved = false;
+  std::string winner_name;
+  double seconds = 0;
+  std::vector<std::unique_ptr<Instance>> instances;
+};
+
+// Runs |threads| diversified solvers on |text| until the first one finishes,
+// then interrupts the rest. Solving is sliced into conflict budgets, between
+// which each thread exports its short learnt clauses to its group's
+// exchange and imports the others'.
+PortfolioResult SolvePortfolio(const std::string& text, const Options& options,
+                               int threads) {
+  PortfolioResult result;
+  result.instances.resize(threads);
+  std::vector<PortfolioConfig> configs;
+  for (int w = 0; w < threads; ++w)
+    configs.push_back(Diversify(options, w));
+  std::unique_ptr<ClauseExchange> exchanges[3];
+  for (auto& exchange : exchanges)
+    exchange.reset(new ClauseExchange);
+
+  std::mutex mutex;
+  std::atomic<int> winner(-1);
+  auto finish = [&](int w, bool solved) {
+    int none = -1;
+    if (!winner.compare_exchange_strong(none, w))
+      return;
+    std::lock_guard<std::mutex> lock(mutex);
+    result.solved = solved;
+    for (auto& instance : result.instances) {
+      if (instance && instance.get() != result.instances[w].get())
+        instance->solver.interrupt();
+    }
+  };
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> workers;
+  for (int w = 0; w < threads; ++w) {
+    workers.emplace_back([&, w]() {
+      auto& config = configs[w];
+      std::istringstream in(text);
+      auto instance = Instance::read(in, config.options);
+      auto& self = *instance;
+      auto& solver = instance->solver.solver();
+      solver.random_seed = config.random_seed;
+      solver.random_var_freq = config.random_var_freq;
+      solver.luby_restart = config.luby_restart;
+      solver.restart_first = config.restart_first;
+      solver.phase_saving = config.phase_saving;
+      solver.rnd_pol = config.rnd_pol;
+      solver.ccmin_mode = config.ccmin_mode;
+      {
+        std::lock_guard<std::mutex> lock(mutex);
+        result.instances[w] = std::move(instance);
+      }
+
+      auto& exchange = *exchanges[config.group];
+      uint64_t cursor = 0;
+      int64_t budget = 1000;
+      Minisat::vec<Minisat::Lit> no_assumptions;
+      while (winner.load() < 0) {
+        solver.setConfBudget(budget);
+        auto status = solver.solveLimited(no_assumptions);
+        if (status == l_True && RefineModel(self))
+          continue;
+        if (status != l_Undef) {
+          finish(w, status == l_True);
+          return;
+        }
+        if (threads == 1)
+          continue;
+
+        solver.ForEachNewLearnt(ClauseExchange::kMaxSize,
+                                [&](const auto& c) { exchange.Publish(w, c); });
+        exchange.Collect(w, &cursor, [&](Minisat::vec<Minisat::Lit>& c) {
+          solver.addClause(c);
+        });
+        budget += budget / 2;
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  result.winner = winner.load();
+  result.winner_name = configs[result.winner].name;
+  result.seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+int RunPortfolio(const Options& options) {
+  std::string text((std::istreambuf_iterator<char>(std::cin)),
+                   std::istreambuf_iterator<char>());
+
+  std::vector<int> counts;
+  if (options.scaling) {
+    for (int t = 1; t < options.portfolio; t *= 2)
+      counts.push_back(t);
+  }
+  counts.push_back(options.portfolio);
+
+  double base = 0;
+  PortfolioResult result;
+  for (int t : counts) {
+    result = SolvePortfolio(text, options, t);
+    if (!base)
+      base = result.seconds;
+    std::cerr << "portfolio: " << t << " threads, " << result.seconds
+              << " s, speedup " << base / result.seconds << ", winner "
+              << result.winner << " (" << result.winner_name << ")\n";
+  }
+
+  auto& instance = result.instances[result.winner];
+  if (!result.solved) {
+    std::cout << NoSolution(instance->options) << "\n";
+    return -1;
+  }
+  instance->solver.solver().printStats();
+  instance->show(std::cout);
+  return 0;
+}
+
+// Edge variables to split on, most central first: the edges across the
+// vertical middle cut ordered by distance from the middle row, then those
+// across the horizontal middle cut.
+std::vector<Minisat::Lit> CubeVariables(Instance& instance) {
+  int width = instance.width, height = instance.height;
+  std::vector<std::pair<int, Minisat::Lit>> vertical, horizontal;
+  for (int i = 0; i < height; ++i) {
+    if (width > 1) {
+      auto& e = instance.edge(i, width / 2, Instance::West);
+      if (!IsConstant(e))
+        vertical.push_back(std::make_pair(std::abs(2 * i - height), e));
+    }
+  }
+  for (int j = 0; j < width; ++j) {
+    if (height > 1) {
+      auto& e = instance.edge(height / 2, j, Instance::North);
+      if (!IsConstant(e))
+        horizontal.push_back(std::make_pair(std::abs(2 * j - width), e));
+    }
+  }
+
+  auto by_distance = [](const std::pair<int, Minisat::Lit>& a,
+                        const std::pair<int, Minisat::Lit>& b) {
+    return a.first < b.first;
+  };
+  std::stable_sort(vertical.begin(), vertical.end(), by_distance);
+  std::stable_sort(horizontal.begin(), horizontal.end(), by_distance);
+
+  std::vector<Minisat::Lit> ret;
+  for (auto& v : vertical)
+    ret.push_back(v.second);
+  for (auto& h : horizontal) {
+    if (std::find(ret.begin(), ret.end(), h.second) == ret.end())
+      ret.push_back(h.second);
+  }
+  return ret;
+}
+
+// A cube fixes the first |lits.size()| cube variables.
+typedef std::vector<Minisat::Lit> Cube;
+
+// One deque of cubes per worker. The owner works at the back, depth first,
+// and idle workers steal from the front, where the largest cubes are.
+class CubeQueues {
+ public:
+  explicit CubeQueues(int workers) : queues_(workers) {}
+
+  void Push(int w, Cube cube) {
+    ++outstanding_;
+    {
+      std::lock_guard<std::mutex> lock(queues_[w].mutex);
+      queues_[w].cubes.push_back(std::move(cube));
+    }
+    // Under idle_mutex_, so that a worker between its last look and wait()
+    // cannot miss the cube.
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_.notify_one();
+  }
+
+  // Takes a cube for worker |w|, sleeping while there is none but others
+  // are still being solved and may split. Returns false once all are done.
+  bool Next(int w, Cube* cube) {
+    std::unique_lock<std::mutex> lock(idle_mutex_);
+    while (!Pop(w, cube) && !Steal(w, cube)) {
+      if (Finished())
+        return false;
+      idle_.wait(lock);
+    }
+    return true;
+  }
+
+  // Marks a cube from Next() as finished, after pushing any cubes it split
+  // into.
+  void Done() {
+    if (--outstanding_ > 0)
+      return;
+    std::lock_guard<std::mutex> lock(idle_mutex_);
+    idle_.notify_all();
+  }
+
+  int64_t stolen() const { return stolen_.load(); }
+
+ private:
+  struct Queue {
+    std::mutex mutex;
+    std::deque<Cube> cubes;
+  };
+
+  bool Finished() const { return outstanding_.load() == 0; }
+
+  bool Pop(int w, Cube* cube) {
+    auto& queue = queues_[w];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.cubes.empty())
+      return false;
+    *cube = std::move(queue.cubes.back());
+    queue.cubes.pop_back();
+    return true;
+  }
+
+  bool Steal(int w, Cube* cube) {
+    for (size_t n = 1; n < queues_.size(); ++n) {
+      auto& queue = queues_[(w + n) % queues_.size()];
+      std::lock_guard<std::mutex> lock(queue.mutex);
+      if (queue.cubes.empty())
+        continue;
+      *cube = std::move(queue.cubes.front());
+      queue.cubes.pop_front();
+      ++stolen_;
+      return true;
+    }
+    return false;
+  }
+
+  std::vector<Queue> queues_;
+  std::mutex idle_mutex_;
+  std::condition_variable idle_;
+  std::atomic<int64_t> outstanding_{0};
+  std::atomic<int64_t> stolen_{0};
+};
+
+int RunCubes(const Options& options) {
+  const int64_t kCubeConflicts = 2000;
+  std::string text((std::istreambuf_iterator<char>(std::cin)),
+                   std::istreambuf_iterator<char>());
+  int threads = options.threads;
+  if (threads <= 0)
+    threads = std::max(1u, std::thread::hardware_concurrency());
+
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::unique_ptr<Instance>> instances(threads);
+  {
+    std::istringstream in(text);
+    instances[0] = Instance::read(in, options);
+  }
+  auto variables = CubeVariables(*instances[0]);
+  int depth = std::min<int>({options.cubes, Options::kMaxCubeDepth,
+                             static_cast<int>(variables.size())});
+
+  CubeQueues queues(threads);
+  for (int c = 0; c < (1 << depth); ++c) {
+    Cube cube;
+    for (int d = 0; d < depth; ++d)
+      cube.push_back(variables[d] ^ ((c >> d) & 1));
+    queues.Push(c % threads, std::move(cube));
+  }
+
+  std::mutex mutex;
+  std::atomic<int> winner(-1);
+  std::atomic<int64_t> solved(0), split(0);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < threads; ++w) {
+    workers.emplace_back([&, w]() {
+      if (!instances[w]) {
+        std::istringstream in(text);
+        auto instance = Instance::read(in, options);
+        std::lock_guard<std::mutex> lock(mutex);
+        instances[w] = std::move(instance);
+        if (winner.load() >= 0)
+          instances[w]->solver.interrupt();
+      }
+      auto& solver = instances[w]->solver.solver();
+
+      Cube cube;
+      Minisat::vec<Minisat::Lit> assumptions;
+      while (queues.Next(w, &cube)) {
+        if (winner.load() >= 0) {
+          queues.Done();
+          continue;
+        }
+
+        assumptions.clear();
+        for (auto& x : cube)
+          assumptions.push(x);
+        bool last = cube.size() == variables.size();
+        if (last)
+          solver.budgetOff();
+        else
+          solver.setConfBudget(kCubeConflicts);
+        auto status = solver.solveLimited(assumptions);
+
+        if (status == l_True && RefineModel(*instances[w])) {
+          queues.Push(w, cube);
+        } else if (status == l_True) {
+          int none = -1;
+          if (winner.compare_exchange_strong(none, w)) {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (auto& instance : instances) {
+              if (instance && instance.get() != instances[w].get())
+                instance->solver.interrupt();
+            }
+          }
+        } else if (status == l_Undef && winner.load() < 0 && !last) {
+          auto x = variables[cube.size()];
+          cube.push_back(x);
+          queues.Push(w, cube);
+          cube.back() = ~x;
+          queues.Push(w, cube);
+          ++split;
+        }
+        ++solved;
+        queues.Done();
+      }
+    });
+  }
+  for (auto& worker : workers)
+    worker.join();
+
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - start).count();
+  std::cerr << "cubes: " << (1 << depth) << " initial, " << split.load()
+            << " split, " << solved.load() << " solved, " << queues.stolen()
+            << " stolen, " << threads << " threads, " << seconds << " s\n";
+
+  if (winner.load() < 0) {
+    std::cout << NoSolution(options) << "\n";
+    return -1;
+  }
+  auto& instance = instances[winner.load()];
+  instance->solver.solver().printStats();
+  instance->show(std::cout);
+  return 0;
+}
+
+// Streams every solution of |instance|, blocking each one on the warm
+// solver before looking for the next, and reports the count and the time
+// per additional solution.
+template <typename Solver>
+int Enumerate(BasicInstance<Solver>& instance, const Options& options) {
+  auto start = std::chrono::steady_clock::now();
+  double first_ms = 0;
+  int64_t count = 0;
+  while (!options.enumerate_limit || count < options.enumerate_limit) {
+    if (!SolveWithoutCycles(instance))
+      break;
+    if (!count++)
+      first_ms = MillisecondsSince(start);
+    if (options.enumerate == Options::All) {
+      instance.show(std::cout);
+      std::cout << std::endl;
+    }
+    instance.BlockSolution();
+  }
+
+  double total_ms = MillisecondsSince(start);
+  bool complete = !options.enumerate_limit || count < options.enumerate_limit;
+  std::cout << "solutions             : " << count
+            << (complete ? "" : " (limit reached)") << '\n';
+  std::cerr << "enumeration: first solution " << first_ms << " ms";
+  if (count > 1) {
+    std::cerr << ", " << (total_ms - first_ms) / (count - 1)
+              << " ms per additional solution";
+  }
+  std::cerr << ", " << total_ms << " ms total\n";
+  return 0;
+}
+
+// Builds |board| on |Solver| and solves it as RunSingle() says.
+template <typename Solver>
+int SolveSingle(const Board& board, const Options& options, double parse_ms) {
+  auto instance = BasicInstance<Solver>::Build(board, options);
+  instance->phases.Record("parse", parse_ms);
+  if (options.cardinality_stats)
+    instance->cardinality_stats.Print(std::cerr);
+  int vars = instance->solver.nVars();
+  int clauses = instance->solver.nClauses();
+  // Writes the stats on the way out with |status|, or -1 if that fails.
+  auto finish = [&](int status) {
+    CountSearch(*instance);
+    if (!WriteStats(instance->phases, options))
+      return -1;
+    return status;
+  };
+  if (options.enumerate != Options::None)
+    return finish(Enumerate(*instance, options));
+
+  if (options.deduce) {
+    auto& deduction = instance->deduction;
+    std::cerr << "deduction: " << deduction.fixed << " of "
+              << deduction.edges << " edges fixed in " << deduction.rounds
+              << " rounds" << (deduction.complete ? ", no search" : "")
+              << "\n";
+  }
+  auto start = std::chrono::steady_clock::now();
+  bool solved = SolveWithoutCycles(*instance);
+  if (instance->simplification.ran) {
+    std::cerr << "simplify: " << instance->simplification.eliminated
+              << " of " << vars << " variables eliminated in "
+              << instance->simplification.simplify_ms << " ms, then "
+              << MillisecondsSince(start) << " ms solving\n";
+  }
+  if (IsLazy(options)) {
+    auto& refinement = instance->refinement;
+    std::cerr << "lazy: " << refinement.rounds << " rounds, "
+              << refinement.cuts << " cuts, " << refinement.refine_ms
+              << " ms refining, " << MillisecondsSince(start) << " ms total\n";
+  }
+  if (!solved) {
+    std::cout << NoSolution(options) << "\n";
+    return finish(-1);
+  }
+
+  PrintSearch(instance->solver);
+  std::cout << "variables             : " << vars << '\n'
+            << "clauses               : " << clauses << '\n';
+  {
+    Phase<Solver> phase(instance->phases, "show", instance->solver);
+    instance->show(std::cout);
+  }
+  if (!options.check_unique)
+    return finish(0);
+
+  // Block the first solution and solve again, keeping what was learnt.
+  instance->BlockSolution();
+  if (!SolveWithoutCycles(*instance)) {
+    std::cout << "unique\n";
+    return finish(0);
+  }
+  std::cout << "multiple\n";
+  instance->show(std::cout);
+  return finish(1);
+}
+
+// One solve of RunCompare(), with the counters its backend reports.
+struct BackendRun {
+  std::string name;
+  bool solved = false;
+  BackendStats stats;
+  double encode_ms = 0, solve_ms = 0;
+};
+
+// Builds |board| on |Solver| into |instance| and solves it, searching even
+// when the deductions decided everything, rather than report no work done.
+template <typename Solver>
+BackendRun CompareOn(const Board& board, const Options& options,
+                     std::unique_ptr<BasicInstance<Solver>>* instance) {
+  BackendRun run;
+  auto start = std::chrono::steady_clock::now();
+  *instance = BasicInstance<Solver>::Build(board, options);
+  run.encode_ms = MillisecondsSince(start);
+  auto& solver = (*instance)->solver;
+  run.name = BackendName(solver);
+  (*instance)->deduced_model = false;
+  auto before = solver.stats();
+  start = std::chrono::steady_clock::now();
+  run.solved = SolveWithoutCycles(**instance);
+  run.solve_ms = MillisecondsSince(start);
+  run.stats = solver.stats().Since(before);
+  return run;
+}
+
+// Builds and solves |board| on each backend in turn, one at a time, and
+// draws the solution of the last, Minisat.
+int RunCompare(const Board& board, const Options& options, double parse_ms) {
+  std::vector<BackendRun> runs;
+  {
+    std::unique_ptr<BasicInstance<CdclBackend<ConnectivityPropagator>>> cdcl;
+    runs.push_back(CompareOn(board, options, &cdcl));
+    ReportPropagator(cdcl->solver);
+  }
+  {
+    std::unique_ptr<BasicInstance<CdclBackend<NoPropagator>>> cdcl;
+    runs.push_back(CompareOn(board, options, &cdcl));
+  }
+#ifdef NUMBER_LINK_HAVE_IPASIR
+  {
+    std::unique_ptr<BasicInstance<IpasirBackend>> ipasir;
+    runs.push_back(CompareOn(board, options, &ipasir));
+  }
+#endif
+  std::unique_ptr<Instance> instance;
+  runs.push_back(CompareOn(board, options, &instance));
+  instance->phases.Record("parse", parse_ms);
+
+  auto counter = [](int64_t n) {
+    return n < 0 ? std::string("-") : std::to_string(n);
+  };
+  for (auto& run : runs) {
+    std::cerr << std::setw(18) << std::left << run.name << std::right
+              << (run.solved ? " sat  " : " unsat")
+              << " conflicts " << std::setw(8) << counter(run.stats.conflicts)
+              << " decisions " << std::setw(8) << counter(run.stats.decisions)
+              << " propagations " << std::setw(10)
+              << counter(run.stats.propagations)
+              << " encode " << run.encode_ms << " ms, solve "
+              << run.solve_ms << " ms\n";
+  }
+  CountSearch(*instance);
+  if (!runs.back().solved) {
+    WriteStats(instance->phases, options);
+    std::cout << NoSolution(options) << "\n";
+    return -1;
+  }
+  std::cout << "variables             : " << instance->solver.nVars() << '\n'
+            << "clauses               : " << instance->solver.nClauses()
+            << '\n';
+  {
+    Phase<SharingBackend> phase(instance->phases, "show", instance->solver);
+    instance->show(std::cout);
+  }
+  return WriteStats(instance->phases, options) ? 0 : -1;
+}
+
+int RunSingle(const Board& board, const Options& options, double parse_ms) {
+  if (options.backend == Backend::Compare)
+    return RunCompare(board, options, parse_ms);
+  return WithBackend(options.backend, [&](auto* backend) {
+    typedef std::remove_pointer_t<decltype(backend)> Solver;
+    return SolveSingle<Solver>(board, options, parse_ms);
+  });
+}
+
+int RunFrontier(const Board& board, const Options& options) {
+  auto start = std::chrono::steady_clock::now();
+  FrontierCounter counter(board.width, board.height, board.pairs,
+                          board.givens, options.enumerate != Options::Count);
+  if (!counter.supported()) {
+    std::cerr << "frontier: too many labels for a frontier "
+              << std::min(board.width, board.height) << " cells wide\n";
+    return -1;
+  }
+  auto count = counter.Run();
+  std::cerr << "frontier: " << FrontierCounter::ToString(count)
+            << " solutions, " << counter.max_states() << " max states, "
+            << MillisecondsSince(start) << " ms\n";
+
+  if (options.enumerate != Options::None) {
+    bool complete = true;
+    if (options.enumerate == Options::All) {
+      int64_t shown = RenderFrontier(counter, board, options.enumerate_limit,
+                                     true, std::cout);
+      complete = count == static_cast<FrontierCounter::Count>(shown);
+    }
+    std::cout << "solutions             : " << FrontierCounter::ToString(count)
+              << (complete ? "" : " (limit reached)") << '\n';
+    return 0;
+  }
+
+  if (!count) {
+    std::cout << NoSolution(options) << "\n";
+    return -1;
+  }
+  RenderFrontier(counter, board, 1, false, std::cout);
+  if (!options.check_unique)
+    return 0;
+  if (count == 1) {
+    std::cout << "unique\n";
+    return 0;
+  }
+  std::cout << "multiple\n";
+  RenderFrontier(counter, board, 2, false, std::cout, 1);
+  return 1;
+}
+
+void Usage(const char* argv0) {
+  std::cerr << "Usage: " << argv0 << " [options] < puzzle\n"
+            << "  --labels=onehot|binary         "
+            << "one variable per label, or the bits of its index\n"
+            << "  --domains=full|reachable       "
+            << "labels per cell in the one-hot encoding\n"
+            << "  --cardinality=STRATEGY         "
+            << "encoding of the per-cell label choice\n"
+            << "  --degree-cardinality=STRATEGY  "
+            << "encoding of the per-cell degree\n"
+            << "  --no-fold                      "
+            << "allocate variables for the givens and pin them by units\n"
+            << "  --connectivity=spanning|lazy|distance\n"
+            << "                                 "
+            << "uniqueness shortcuts, lazy loop cuts, or distances\n"
+            << "  --distance=binary|order        "
+            << "encoding of --connectivity=distance\n"
+            << "  --no-spanning-unique           "
+            << "same as --connectivity=lazy\n"
+            << "  --engine=labels|edges|bitboard|frontier\n"
+            << "                                 "
+            << "encode labels, only edges with lazy label cuts,\n"
+            << "                                 "
+            << "search natively on bitboards, or count by frontier DP\n"
+            << "  --backend=minisat|cdcl|ipasir|compare\n"
+            << "                                 "
+            << "solve on Minisat, on CdclSolver with a connectivity\n"
+            << "                                 "
+            << "propagator, on the IPASIR solver built in, or on all\n"
+            << "  --simplify[=on|off]            "
+            << "eliminate variables first\n"
+            << "  --no-deduce                    "
+            << "skip the local deduction rules before solving\n"
+            << "  --check-unique                 "
+            << "look for a second solution on the same solver,\n"
+            << "                                 "
+            << "without the uniqueness shortcuts\n"
+            << "  --all[=LIMIT], --count[=LIMIT] "
+            << "print or count every solution, up to LIMIT\n"
+            << "                                 "
+            << "(use with --no-spanning-unique to see them all)\n"
+            << "  --cardinality-stats            "
+            << "report clauses and aux vars per strategy\n"
+            << "  --stats=json                   "
+            << "time and clauses per phase as JSON on stderr\n"
+            << "  --stats-file=PATH              "
+            << "the same into PATH\n"
+            << "  --batch=SOURCE                 "
+            << "solve a directory, @list, file or - of puzzles as JSON lines\n"
+            << "  --threads=N                    "
+            << "batch worker threads, one per core by default\n"
+            << "  --portfolio=N                  "
+            << "race N diversified solvers sharing learnt clauses\n"
+            << "  --cubes=DEPTH                  "
+            << "split into 2^DEPTH cubes solved on --threads workers,\n"
+            << "                                 "
+            << "DEPTH up to 20\n"
+            << "  --templates                    "
+            << "reuse one batch solver per shape, givens as assumptions\n"
+            << "  --scaling                      "
+            << "repeat a batch or portfolio at 1, 2, 4, ... threads\n"
+            << "STRATEGY is one of auto, binomial, sequential, totalizer, "
+            << "commander, product.\n";
+}
+
+bool ParseOptions(int argc, char** argv, Options* options) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    auto value = [&](const std::string& prefix, std::string* v) {
+      if (arg.compare(0, prefix.size(), prefix) != 0)
+        return false;
+      *v = arg.substr(prefix.size());
+      return true;
+    };
+    // Reads all of |v| as a decimal integer from |min| to |max|.
+    auto integer = [](const std::string& v, int64_t min, int64_t max,
+                      int64_t* n) {
+      if (v.empty() || std::isspace(static_cast<unsigned char>(v[0])))
+        return false;
+      char* end;
+      errno = 0;
+      long long x = std::strtoll(v.c_str(), &end, 10);
+      if (*end || errno == ERANGE || x < min || x > max)
+        return false;
+      *n = x;
+      return true;
+    };
+    int64_t n;
+
+    std::string v;
+    if (value("--labels=", &v)) {
+      if (v == "onehot")
+        options->label_encoding = LabelEncoding::OneHot;
+      else if (v == "binary")
+        options->label_encoding = LabelEncoding::Binary;
+      else
+        return false;
+    } else if (value("--domains=", &v)) {
+      if (v == "full")
+        options->domains = Domains::Full;
+      else if (v == "reachable")
+        options->domains = Domains::Reachable;
+      else
+        return false;
+    } else if (value("--cardinality=", &v)) {
+      if (!ParseCardinality(v, &options->assignment_cardinality))
+        return false;
+    } else if (value("--degree-cardinality=", &v)) {
+      if (!ParseCardinality(v, &options->degree_cardinality))
+        return false;
+    } else if (arg == "--no-fold") {
+      options->fold_constants = false;
+    } else if (value("--connectivity=", &v)) {
+      if (v == "spanning")
+        options->connectivity = Connectivity::Spanning;
+      else if (v == "lazy")
+        options->connectivity = Connectivity::Lazy;
+      else if (v == "distance")
+        options->connectivity = Connectivity::Distance;
+      else
+        return false;
+    } else if (value("--distance=", &v)) {
+      if (v == "order")
+        options->distance_encoding = DistanceEncoding::Order;
+      else if (v == "binary")
+        options->distance_encoding = DistanceEncoding::Binary;
+      else
+        return false;
+    } else if (value("--engine=", &v)) {
+      if (v == "labels")
+        options->engine = Engine::Labels;
+      else if (v == "edges")
+        options->engine = Engine::Edges;
+      else if (v == "bitboard")
+        options->engine = Engine::Bitboard;
+      else if (v == "frontier")
+        options->engine = Engine::Frontier;
+      else
+        return false;
+    } else if (value("--backend=", &v)) {
+      if (v == "minisat")
+        options->backend = Backend::Minisat;
+      else if (v == "cdcl")
+        options->backend = Backend::Cdcl;
+      else if (v == "ipasir")
+        options->backend = Backend::Ipasir;
+      else if (v == "compare")
+        options->backend = Backend::Compare;
+      else
+        return false;
+    } else if (arg == "--simplify") {
+      options->simplification = Simplification::On;
+    } else if (value("--simplify=", &v)) {
+      if (v == "off")
+        options->simplification = Simplification::Off;
+      else if (v == "on")
+        options->simplification = Simplification::On;
+      else
+        return false;
+    } else if (arg == "--no-spanning-unique") {
+      options->connectivity = Connectivity::Lazy;
+    } else if (arg == "--no-deduce") {
+      options->deduce = false;
+    } else if (arg == "--check-unique") {
+      options->check_unique = true;
+    } else if (arg == "--all" || arg == "--count") {
+      options->enumerate = arg == "--all" ? Options::All : Options::Count;
+    } else if (value("--all=", &v) || value("--count=", &v)) {
+      options->enumerate = arg[2] == 'a' ? Options::All : Options::Count;
+      if (!integer(v, 0, INT64_MAX, &options->enumerate_limit))
+        return false;
+    } else if (arg == "--cardinality-stats") {
+      options->cardinality_stats = true;
+    } else if (value("--batch=", &v)) {
+      options->batch.push_back(v);
+    } else if (value("--threads=", &v)) {
+      if (!integer(v, 0, INT_MAX, &n))
+        return false;
+      options->threads = n;
+    } else if (value("--portfolio=", &v)) {
+      if (!integer(v, 0, INT_MAX, &n))
+        return false;
+      options->portfolio = n;
+    } else if (value("--cubes=", &v)) {
+      if (!integer(v, 0, Options::kMaxCubeDepth, &n))
+        return false;
+      options->cubes = n;
+    } else if (value("--stats=", &v)) {
+      if (v != "json")
+        return false;
+      options->stats = true;
+    } else if (value("--stats-file=", &v)) {
+      options->stats = true;
+      options->stats_file = v;
+    } else if (arg == "--templates") {
+      options->templates = true;
+    } else if (arg == "--scaling") {
+      options->scaling = true;
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,1651 @@
+#ifndef NUMBER_LINK_NUMBER_LINK_H_
+#define NUMBER_LINK_NUMBER_LINK_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <initializer_list>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "minisat/core/Solver.h"
+#include "minisat/simp/SimpSolver.h"
+
+#include "backend.h"
+#include "bitboard.h"
+#include "cardinality.h"
+#include "deduction.h"
+#include "stats.h"
+
+// The SAT encoding of a Numberlink puzzle in Instance, and the drivers that
+// solve one, a batch, a portfolio or cubes of it. main.cc and the tools
+// (bench, microbench, generate) are built on them with number_link.cc.
+
+// Literals known at parse time are the constants kTrue and kFalse. Both are
+// on var_Undef, so they never reach the solver as long as clauses go
+// through a ConstantFolder.
+const Minisat::Lit kTrue = Minisat::mkLit(var_Undef);
+const Minisat::Lit kFalse = ~kTrue;
+
+inline bool IsConstant(const Minisat::Lit& x) {
+  return Minisat::var(x) == var_Undef;
+}
+
+// Literals in place, for a clause passed on without copying it.
+struct Literals {
+  const Minisat::Lit* lits;
+  int n;
+
+  int size() const { return n; }
+  const Minisat::Lit& operator[](int i) const { return lits[i]; }
+};
+
+// Minisat::SimpSolver with read access to its learnt clauses, so that
+// portfolio threads can share them.
+class SharingSolver : public Minisat::SimpSolver {
+ public:
+  // Leaves a plain Minisat::Solver, as eliminate(true) does afterwards.
+  // Call it before adding any variable.
+  void DisableSimplification() {
+    use_simplification = false;
+    remove_satisfied = true;
+    ca.extra_clause_field = false;
+  }
+
+  // Calls |f| with each learnt clause of at most |max_size| literals that
+  // was learnt since the last call. Clauses are allocated past the arena
+  // end of that call until a garbage collection moves them, so the new ones
+  // are set aside before one.
+  template <typename F>
+  void ForEachNewLearnt(int max_size, F f) {
+    max_new_size_ = max_size;
+    size_t begin = 0;
+    for (int n : pending_sizes_) {
+      f(Literals{&pending_[begin], n});
+      begin += n;
+    }
+    pending_.clear();
+    pending_sizes_.clear();
+    for (int i = 0; i < learnts.size(); ++i) {
+      if (learnts[i] >= watermark_ && ca[learnts[i]].size() <= max_size)
+        f(ca[learnts[i]]);
+    }
+    watermark_ = ca.size();
+  }
+
+  void garbageCollect() override {
+    for (int i = 0; max_new_size_ && i < learnts.size(); ++i) {
+      auto& c = ca[learnts[i]];
+      if (learnts[i] < watermark_ || c.size() > max_new_size_)
+        continue;
+      pending_sizes_.push_back(c.size());
+      for (int k = 0; k < c.size(); ++k)
+        pending_.push_back(c[k]);
+    }
+    Minisat::SimpSolver::garbageCollect();
+    watermark_ = ca.size();
+  }
+
+ private:
+  // The arena end at the last ForEachNewLearnt(), and the short clauses
+  // learnt since then that a garbage collection has moved below it.
+  Minisat::CRef watermark_ = 0;
+  int max_new_size_ = 0;
+  std::vector<Minisat::Lit> pending_;
+  std::vector<int> pending_sizes_;
+};
+
+// The Minisat backend Instance is built on unless another is asked for,
+// and the only one portfolio and cube workers run on.
+typedef MinisatBackend<SharingSolver> SharingBackend;
+
+// Clause sink in front of a backend (see backend.h) that drops clauses
+// satisfied by kTrue and strips kFalse from the rest, then hands them on
+// as Literals. It has the addClause() overloads of a Minisat::Solver, so
+// the encoders in cardinality.h take it as their sink.
+template <typename Solver>
+struct ConstantFolder {
+  Solver& solver;
+
+  explicit ConstantFolder(Solver& solver) : solver(solver) {}
+
+  Minisat::Var newVar() { return solver.newVar(); }
+
+  bool addClause(const Minisat::vec<Minisat::Lit>& ps) {
+    int i = 0;
+    while (i < ps.size() && !IsConstant(ps[i]))
+      ++i;
+    if (i == ps.size())
+      return solver.addClause(ps);
+
+    Minisat::vec<Minisat::Lit> folded;
+    for (i = 0; i < ps.size(); ++i) {
+      if (ps[i] == kTrue)
+        return true;
+      if (ps[i] != kFalse)
+        folded.push(ps[i]);
+    }
+    return solver.addClause(folded);
+  }
+
+  bool addClause(Minisat::Lit p) { return addFolded({p}); }
+
+  bool addClause(Minisat::Lit p, Minisat::Lit q) {
+    return addFolded({p, q});
+  }
+
+  bool addClause(Minisat::Lit p, Minisat::Lit q, Minisat::Lit r) {
+    return addFolded({p, q, r});
+  }
+
+  bool addClause(Minisat::Lit p, Minisat::Lit q,
+                 Minisat::Lit r, Minisat::Lit s) {
+    return addFolded({p, q, r, s});
+  }
+
+  bool addEmptyClause() { return solver.addClause(Literals{nullptr, 0}); }
+
+ private:
+  bool addFolded(std::initializer_list<Minisat::Lit> ps) {
+    Minisat::Lit rest[4];
+    int n = 0;
+    for (auto& p : ps) {
+      if (p == kTrue)
+        return true;
+      if (p != kFalse)
+        rest[n++] = p;
+    }
+    return solver.addClause(Literals{rest, n});
+  }
+};
+
+template <typename Solver>
+void Equiv(Solver& solver,
+           const Minisat::Lit& x,
+           const Minisat::Lit& y) {
+  // x <=> y
+  // x => y & y => x
+  // (~x || y) & (x || ~y)
+  solver.addClause(~x, y);
+  solver.addClause(x, ~y);
+}
+
+template <typename Solver>
+void Glue(Solver& solver,
+          const Minisat::Lit& g,
+          const Minisat::Lit& x,
+          const Minisat::Lit& y) {
+  // g => (x <=> y)
+  // ~g || ((~x || y) & (x || ~y))
+  // (~g || ~x || y) & (~g || x || ~y)
+  solver.addClause(~g, ~x, y);
+  solver.addClause(~g, x, ~y);
+}
+
+template <typename Solver>
+void Stick(Solver& solver,
+           const Minisat::Lit& g,
+           const Minisat::Lit& x,
+           const Minisat::Lit& y) {
+  // (x & y) => g
+  // g || ~x || ~y
+  solver.addClause(g, ~x, ~y);
+}
+
+template <typename Solver>
+void Corner(Solver& solver,
+            const Minisat::Lit& e,
+            const Minisat::Lit& f,
+            const Minisat::Lit& s,
+            const Minisat::Lit& x,
+            const Minisat::Lit& y) {
+  // (e & f) => (s | x) & (s | y)
+  solver.addClause(~e, ~f, s, x);
+  solver.addClause(~e, ~f, s, y);
+}
+
+enum class LabelEncoding {
+  OneHot, Binary
+};
+
+enum class Domains {
+  Full, Reachable
+};
+
+// How paths are kept from forming closed loops. Spanning adds the Stick and
+// CornerPropagation constraints, which are only sound for puzzles with a
+// unique solution. Lazy omits them and cuts the loops of each model
+// until none is left. Distance directs each path away from its first
+// endpoint and numbers its cells in order, which no loop can satisfy.
+enum class Connectivity {
+  Spanning, Lazy, Distance
+};
+
+// How the distances of Connectivity::Distance are encoded: Order has a
+// literal per cell and distance for "at least", Binary has the bits.
+enum class DistanceEncoding {
+  Order, Binary
+};
+
+// What the CNF encodes. Labels has a label per cell, linked along the
+// edges. Edges has only the edges and sinks with their degrees; the paths
+// of each model are traced, and those joining two different labels or
+// closing a loop are cut until none is left. Bitboard skips SAT for
+// BitboardSolver on boards up to 64 columns wide, and Frontier for
+// FrontierCounter, which counts every solution exactly.
+enum class Engine {
+  Labels, Edges, Bitboard, Frontier
+};
+
+// What the CNF is built on and solved by: Minisat's SimpSolver, CdclSolver
+// with the ConnectivityPropagator, or the solver linked in through IPASIR.
+// Compare builds and solves it on each of these, and CdclSolver alone, in
+// turn.
+enum class Backend {
+  Minisat, Cdcl, Ipasir, Compare
+};
+
+// Whether SimpSolver eliminates variables before the first solve. It is
+// opt-in until its cost has been weighed against the search it saves.
+enum class Simplification {
+  Off, On
+};
+
+struct Options {
+  LabelEncoding label_encoding = LabelEncoding::OneHot;
+  Domains domains = Domains::Reachable;
+  Cardinality assignment_cardinality = Cardinality::Auto;
+  Cardinality degree_cardinality = Cardinality::Auto;
+  bool fold_constants = true;
+  Connectivity connectivity = Connectivity::Spanning;
+  DistanceEncoding distance_encoding = DistanceEncoding::Binary;
+  Engine engine = Engine::Labels;
+  Backend backend = Backend::Minisat;
+  Simplification simplification = Simplification::Off;
+  // Whether to run the Deduction rules first and add what they fix.
+  bool deduce = true;
+  // Whether to look for a second solution after the first one.
+  bool check_unique = false;
+  // Enumeration of all solutions: whether to print or only count them, and
+  // how many to stop at (0 for no limit).
+  enum Enumerate {
+    None, All, Count
+  } enumerate = None;
+  int64_t enumerate_limit = 0;
+  bool cardinality_stats = false;
+  // Whether to write PhaseStats as JSON, to |stats_file| or else stderr.
+  bool stats = false;
+  std::string stats_file;
+
+  // Batch mode: puzzle sources, worker threads (0 for one per core),
+  // whether to repeat the batch at 1, 2, 4, ... threads, and whether each
+  // worker reuses one solver per puzzle shape.
+  std::vector<std::string> batch;
+  int threads = 0;
+  bool scaling = false;
+  bool templates = false;
+
+  // Portfolio mode: the number of diversified solver threads on one puzzle.
+  int portfolio = 0;
+
+  // Cube-and-conquer mode: the depth of the initial split into cubes, up
+  // to kMaxCubeDepth.
+  int cubes = 0;
+  static const int kMaxCubeDepth = 20;
+};
+
+// A puzzle as read: its rows, its labels in order of first appearance, the
+// label index of each endpoint cell and -1 elsewhere, and the endpoint cells
+// of each label.
+struct Board {
+  std::vector<std::string> input;
+  std::vector<char> labels;
+  int pairs = 0, width = 0, height = 0;
+  std::vector<int> givens;
+  std::vector<std::vector<int>> endpoints;
+};
+
+// SimpSolver's variable elimination, which only the Minisat backend has;
+// the others take the CNF as it is built.
+template <typename Solver>
+void DisableSimplification(Solver&) {}
+
+inline void DisableSimplification(SharingBackend& backend) {
+  backend.solver().DisableSimplification();
+}
+
+// Freezes the variables of |frozen| and eliminates others where it pays,
+// then turns elimination off. Returns whether it ran, and sets |eliminated|.
+template <typename Solver>
+bool Eliminate(Solver&,
+               std::initializer_list<const std::vector<Minisat::Lit>*>,
+               int*) {
+  return false;
+}
+
+inline bool Eliminate(
+    SharingBackend& backend,
+    std::initializer_list<const std::vector<Minisat::Lit>*> frozen,
+    int* eliminated) {
+  auto& solver = backend.solver();
+  for (auto* lits : frozen) {
+    for (auto& x : *lits) {
+      if (!IsConstant(x))
+        solver.setFrozen(Minisat::var(x), true);
+    }
+  }
+  solver.eliminate(true);
+  *eliminated = solver.eliminated_vars;
+  return true;
+}
+
+template <typename Solver>
+struct BasicInstance;
+class ConnectivityPropagator;
+
+// Gives the backend of a built |instance| the propagator that reads its
+// variables and givens. Only CdclBackend has one.
+template <typename Solver>
+void Connect(BasicInstance<Solver>&) {}
+void Connect(BasicInstance<CdclBackend<ConnectivityPropagator>>& instance);
+
+// A puzzle encoded on |Solver|, one of the backends of backend.h; Instance
+// is the one on Minisat.
+template <typename Solver>
+struct BasicInstance {
+  enum Direction {
+    Sink = 0, North, South, East, West
+  };
+
+  Solver solver;
+  ConstantFolder<Solver> folder;
+  Options options;
+  CardinalityStats cardinality_stats;
+  // Time and clauses by phase, kept with --stats.
+  PhaseStats phases;
+  // Work done by SolveWithoutCycles() to cut closed loops out of models.
+  struct RefinementStats {
+    int64_t rounds = 0;
+    int64_t cuts = 0;
+    double refine_ms = 0;
+  } refinement;
+  // What the Deduction rules fixed: the rounds to their fixed point, the
+  // edge variables they decided out of all, and whether that was all of
+  // them, in which case the first solve takes their model instead of
+  // searching.
+  struct DeductionStats {
+    int rounds = 0;
+    int fixed = 0;
+    int edges = 0;
+    bool complete = false;
+  } deduction;
+  // What Simplify() did: the variables it eliminated, in how long.
+  struct SimplificationStats {
+    bool ran = false;
+    int eliminated = 0;
+    double simplify_ms = 0;
+  } simplification;
+  // Whether SetDeducedModel() left |deduced| as the model of the next
+  // solve, and whether it is the last model rather than the solver's.
+  bool deduced_model = false;
+  bool last_deduced = false;
+  std::vector<Minisat::lbool> deduced;
+  std::vector<char> labels;
+  int pairs, width, height;
+  // The label index of each endpoint cell and -1 elsewhere.
+  std::vector<int> givens;
+  // Bits per cell in the binary encoding.
+  int label_width;
+  // In the one-hot encoding, the labels cell c may take are
+  // domain_labels[domain_begin[c]..domain_begin[c + 1]) in increasing order,
+  // and their literals are at the same positions in |assignments|.
+  std::vector<int> domain_begin;
+  std::vector<int> domain_labels;
+  std::vector<Minisat::Lit> assignments;
+  std::vector<Minisat::Lit> sinks;
+  std::vector<Minisat::Lit> east_west;
+  std::vector<Minisat::Lit> north_south;
+  // With distance connectivity, the edges directed away from the first
+  // endpoint of their path, at the positions of the edges in |east_west| and
+  // |north_south|: |east_flow| is the edge taken eastwards, and so on.
+  std::vector<Minisat::Lit> east_flow, west_flow, south_flow, north_flow;
+  // The distance of each cell from the first endpoint of its path, as
+  // DistanceEncoding says.
+  std::vector<std::vector<Minisat::Lit>> distances;
+
+  // A fresh variable, or a constant if |fixed| is 0 or 1 and folding is on.
+  Minisat::Lit MakeLiteral(int fixed = -1) {
+    if (fixed >= 0 && options.fold_constants)
+      return fixed ? kTrue : kFalse;
+    return Minisat::mkLit(solver.newVar());
+  }
+
+  BasicInstance() = delete;
+  BasicInstance(const BasicInstance&) = delete;
+  BasicInstance(BasicInstance&&) = delete;
+  BasicInstance& operator=(const BasicInstance&) = delete;
+  BasicInstance& operator=(BasicInstance&&) = delete;
+
+  // |domains| lists the labels of each cell for the one-hot encoding and
+  // the edges engine, which uses them only to fold edges.
+  BasicInstance(const Options& options,
+                std::vector<char> labels, int pairs, int width, int height,
+                const std::vector<int>& givens,
+                const std::vector<std::vector<int>>& domains)
+      : folder(solver),
+        options(options),
+        labels(std::move(labels)),
+        pairs(pairs), width(width), height(height),
+        givens(givens),
+        label_width(LabelBits(pairs)),
+        domain_begin(1, 0) {
+    phases.Enable(options.stats);
+    Phase<Solver> phase(phases, "variables", solver);
+    if (!Simplifies(options))
+      DisableSimplification(solver);
+    int cells = width * height;
+    if (binary()) {
+      for (int c = 0; c < cells; ++c) {
+        for (int b = 0; b < label_width; ++b)
+          assignments.push_back(
+              MakeLiteral(givens[c] < 0 ? -1 : (givens[c] >> b) & 1));
+      }
+    } else {
+      for (int c = 0; c < cells; ++c) {
+        for (int k : domains[c]) {
+          domain_labels.push_back(k);
+          if (!edges_only()) {
+            assignments.push_back(
+                MakeLiteral(givens[c] < 0 ? -1 : k == givens[c]));
+          }
+        }
+        domain_begin.push_back(domain_labels.size());
+      }
+    }
+
+    for (int c = 0; c < cells; ++c)
+      sinks.push_back(MakeLiteral(givens[c] >= 0));
+
+    // Walls are false, and so are edges between cells that cannot share a
+    // label.
+    auto link = [&](int c, int d) {
+      if (givens[c] >= 0 && givens[d] >= 0 && givens[c] != givens[d])
+        return MakeLiteral(0);
+      if (!binary() &&
+          !ForEachCommonLabel(c / width, c % width, d / width, d % width,
+                              [](int, int) {}))
+        return MakeLiteral(0);
+      return MakeLiteral();
+    };
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j <= width; ++j) {
+        if (j == 0 || j == width)
+          east_west.push_back(MakeLiteral(0));
+        else
+          east_west.push_back(link(i * width + j - 1, i * width + j));
+      }
+    }
+    for (int i = 0; i <= height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        if (i == 0 || i == height)
+          north_south.push_back(MakeLiteral(0));
+        else
+          north_south.push_back(link((i - 1) * width + j, i * width + j));
+      }
+    }
+  }
+
+  ~BasicInstance() {}
+
+  static bool Simplifies(const Options& options) {
+    return options.simplification == Simplification::On;
+  }
+
+  // Freezes the variables that models are read from and that later clauses
+  // and assumptions use, then has SimpSolver eliminate the rest where it
+  // pays and turn elimination off.
+  void Simplify() {
+    if (!Simplifies(options))
+      return;
+    Phase<Solver> phase(phases, "simplify", solver);
+    auto start = std::chrono::steady_clock::now();
+    simplification.ran =
+        Eliminate(solver, {&assignments, &sinks, &east_west, &north_south},
+                  &simplification.eliminated);
+    simplification.simplify_ms = std::chrono::duration<double, std::milli>(
+        std::chrono::steady_clock::now() - start).count();
+  }
+
+  static int LabelBits(int pairs) {
+    int bits = 1;
+    while ((1 << bits) < pairs)
+      ++bits;
+    return bits;
+  }
+
+  bool binary() const {
+    return !edges_only() && options.label_encoding == LabelEncoding::Binary;
+  }
+
+  bool edges_only() const {
+    return options.engine == Engine::Edges;
+  }
+
+  // The literal of label |k| at cell (i, j), or nullptr if |k| is outside the
+  // cell's domain.
+  const Minisat::Lit* find_assignment(int i, int j, int k) const {
+    assert(!binary());
+    assert(0 <= i && i < height);
+    assert(0 <= j && j < width);
+    assert(0 <= k && k < pairs);
+    int c = i * width + j;
+    auto begin = domain_labels.begin() + domain_begin[c];
+    auto end = domain_labels.begin() + domain_begin[c + 1];
+    auto itr = std::lower_bound(begin, end, k);
+    if (itr == end || *itr != k)
+      return nullptr;
+    return &assignments[itr - domain_labels.begin()];
+  }
+
+  const Minisat::Lit& assignment(int i, int j, int k) const {
+    auto x = find_assignment(i, j, k);
+    assert(x);
+    return *x;
+  }
+
+  // Calls |f| with each label and literal in the domain of cell (i, j).
+  template <typename F>
+  void ForEachAssignment(int i, int j, F f) const {
+    int c = i * width + j;
+    for (int p = domain_begin[c]; p < domain_begin[c + 1]; ++p)
+      f(domain_labels[p], assignments[p]);
+  }
+
+
+  const Minisat::Lit& label_bit(int i, int j, int b) {
+    assert(binary());
+    assert(0 <= i && i < height);
+    assert(0 <= j && j < width);
+    assert(0 <= b && b < label_width);
+    return assignments[(i * width + j) * label_width + b];
+  }
+
+  // The literal of bit |b| of cell (i, j) that holds when the cell's label
+  // agrees with label |k| on that bit.
+  Minisat::Lit label_bit(int i, int j, int b, int k) {
+    return label_bit(i, j, b) ^ !((k >> b) & 1);
+  }
+
+  const Minisat::Lit& edge(int i, int j, Direction d) const {
+    assert(0 <= i && i < height);
+    assert(0 <= j && j < width);
+    switch (d) {
+      case Sink:
+        return sinks[i * width + j];
+      case East:
+      case West:
+        return east_west[i * (width + 1) + j + (d == East ? 1 : 0)];
+      case North:
+      case South:
+        return north_south[(i + (d == South ? 1 : 0)) * width + j];
+    }
+    assert(false);
+  }
+
+  // The edge of cell (i, j) in direction |d| taken out of the cell, or into
+  // it if |in|.
+  const Minisat::Lit& flow(int i, int j, Direction d, bool in = false) const {
+    assert(d != Sink);
+    if (d == East || d == West) {
+      int p = i * (width + 1) + j + (d == East ? 1 : 0);
+      return (d == East) != in ? east_flow[p] : west_flow[p];
+    }
+    int p = (i + (d == South ? 1 : 0)) * width + j;
+    return (d == South) != in ? south_flow[p] : north_flow[p];
+  }
+
+  void SetUpBasicConstraints() {
+    if (edges_only()) {
+      SetUpWallConstraints();
+      SetUpDegreeConstraints();
+      return;
+    }
+    SetUpAssignmentConstraints();
+    SetUpWallConstraints();
+    SetUpDegreeConstraints();
+    SetUpLinkConstraints();
+  }
+
+  void SetUpSpanningUniqueConstraints() {
+    SetUpStickConstraints();
+    SetUpCornerPropagationConstraints();
+  }
+
+  void SetUpAssignmentConstraints() {
+    Phase<Solver> phase(phases, "assignment", solver);
+    if (binary()) {
+      SetUpBinaryAssignmentConstraints();
+      return;
+    }
+
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        std::vector<Minisat::Lit> xs;
+        ForEachAssignment(i, j, [&](int, const Minisat::Lit& x) {
+          xs.push_back(x);
+        });
+        FoldedExact(1, xs, options.assignment_cardinality);
+      }
+    }
+  }
+
+  // Exact(k) over |xs| after taking the constants out of it.
+  void FoldedExact(int k, std::vector<Minisat::Lit> xs, Cardinality c) {
+    auto folded = xs.begin();
+    for (auto& x : xs) {
+      if (x == kTrue)
+        --k;
+      else if (x != kFalse)
+        *folded++ = x;
+    }
+    xs.erase(folded, xs.end());
+    if (k < 0 || k > static_cast<int>(xs.size())) {
+      folder.addEmptyClause();
+      return;
+    }
+    Exact(folder, k, xs, c,
+          options.cardinality_stats ? &cardinality_stats : nullptr);
+  }
+
+  // Excludes the codes from |pairs| to 2^label_width - 1: for each bit where
+  // pairs - 1 has a 0, setting it requires clearing some higher bit where
+  // pairs - 1 has a 1.
+  void SetUpBinaryAssignmentConstraints() {
+    int max_label = pairs - 1;
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        for (int b = 0; b < label_width; ++b) {
+          if ((max_label >> b) & 1)
+            continue;
+          Minisat::vec<Minisat::Lit> clause;
+          clause.push(~label_bit(i, j, b));
+          for (int c = b + 1; c < label_width; ++c) {
+            if ((max_label >> c) & 1)
+              clause.push(~label_bit(i, j, c));
+          }
+          folder.addClause(clause);
+        }
+      }
+    }
+  }
+
+  void SetUpWallConstraints() {
+    Phase<Solver> phase(phases, "wall", solver);
+    for (int i = 0; i < height; ++i) {
+      folder.addClause(~edge(i, 0, West));
+      folder.addClause(~edge(i, width - 1, East));
+    }
+    for (int j = 0; j < width; ++j) {
+      folder.addClause(~edge(0, j, North));
+      folder.addClause(~edge(height - 1, j, South));
+    }
+  }
+
+  void SetUpDegreeConstraints() {
+    Phase<Solver> phase(phases, "degree", solver);
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        std::vector<Minisat::Lit> xs;
+        for (int d = Sink; d <= West; ++d)
+          xs.push_back(edge(i, j, static_cast<Direction>(d)));
+        FoldedExact(2, xs, options.degree_cardinality);
+      }
+    }
+  }
+
+  void SetUpLinkConstraints() {
+    Phase<Solver> phase(phases, "link", solver);
+    if (binary()) {
+      ForEachLink([&](const Minisat::Lit& e, int i, int j, int ii, int jj) {
+        for (int b = 0; b < label_width; ++b)
+          Glue(folder, e, label_bit(i, j, b), label_bit(ii, jj, b));
+      });
+      return;
+    }
+
+    // Labels in both domains are glued. A label in only one of them rules
+    // the edge out for that label, and the edge is dropped entirely when
+    // the domains are disjoint.
+    ForEachLink([&](const Minisat::Lit& e, int i, int j, int ii, int jj) {
+      if (!ForEachCommonLabel(i, j, ii, jj, [](int, int) {})) {
+        folder.addClause(~e);
+        return;
+      }
+
+      int c = i * width + j;
+      int d = ii * width + jj;
+      int p = domain_begin[c], q = domain_begin[d];
+      while (p < domain_begin[c + 1] || q < domain_begin[d + 1]) {
+        if (q == domain_begin[d + 1] ||
+            (p < domain_begin[c + 1] && domain_labels[p] < domain_labels[q])) {
+          folder.addClause(~e, ~assignments[p++]);
+        } else if (p == domain_begin[c + 1] ||
+                   domain_labels[q] < domain_labels[p]) {
+          folder.addClause(~e, ~assignments[q++]);
+        } else {
+          Glue(folder, e, assignments[p++], assignments[q++]);
+        }
+      }
+    });
+  }
+
+  // Calls |f| with the positions in |assignments| of every label shared by
+  // the domains of (i, j) and (ii, jj). Returns whether there was any.
+  template <typename F>
+  bool ForEachCommonLabel(int i, int j, int ii, int jj, F f) const {
+    int c = i * width + j;
+    int d = ii * width + jj;
+    int p = domain_begin[c], q = domain_begin[d];
+    bool found = false;
+    while (p < domain_begin[c + 1] && q < domain_begin[d + 1]) {
+      if (domain_labels[p] < domain_labels[q]) {
+        ++p;
+      } else if (domain_labels[q] < domain_labels[p]) {
+        ++q;
+      } else {
+        f(p++, q++);
+        found = true;
+      }
+    }
+    return found;
+  }
+
+  void SetUpStickConstraints() {
+    Phase<Solver> phase(phases, "stick", solver);
+    if (binary()) {
+      // (label(i, j) == label(ii, jj)) => e, through a difference variable
+      // per bit: d => (x != y).
+      ForEachLink([&](const Minisat::Lit& e, int i, int j, int ii, int jj) {
+        Minisat::vec<Minisat::Lit> clause;
+        clause.push(e);
+        for (int b = 0; b < label_width; ++b) {
+          auto d = Minisat::mkLit(solver.newVar());
+          auto& x = label_bit(i, j, b);
+          auto& y = label_bit(ii, jj, b);
+          folder.addClause(~d, x, y);
+          folder.addClause(~d, ~x, ~y);
+          clause.push(d);
+        }
+        folder.addClause(clause);
+      });
+      return;
+    }
+
+    ForEachLink([&](const Minisat::Lit& e, int i, int j, int ii, int jj) {
+      ForEachCommonLabel(i, j, ii, jj, [&](int p, int q) {
+        Stick(folder, e, assignments[p], assignments[q]);
+      });
+    });
+  }
+
+  // Calls |f| with the edge literal and both cells of every inner edge.
+  template <typename F>
+  void ForEachLink(F f) {
+    for (int i = 1; i < height; ++i)
+      for (int j = 0; j < width; ++j)
+        f(edge(i, j, North), i, j, i - 1, j);
+
+    for (int i = 0; i < height; ++i)
+      for (int j = 1; j < width; ++j)
+        f(edge(i, j, West), i, j, i, j - 1);
+  }
+
+  void SetUpDistanceConstraints() {
+    Phase<Solver> phase(phases, "distance", solver);
+    // Each edge is taken one way: e <=> (f | b) and ~(f & b).
+    auto direct = [&](const std::vector<Minisat::Lit>& edges,
+                      std::vector<Minisat::Lit>* forward,
+                      std::vector<Minisat::Lit>* backward) {
+      for (auto& e : edges) {
+        auto f = MakeLiteral(e == kFalse ? 0 : -1);
+        auto b = MakeLiteral(e == kFalse ? 0 : -1);
+        folder.addClause(~e, f, b);
+        folder.addClause(e, ~f);
+        folder.addClause(e, ~b);
+        folder.addClause(~f, ~b);
+        forward->push_back(f);
+        backward->push_back(b);
+      }
+    };
+    direct(east_west, &east_flow, &west_flow);
+    direct(north_south, &south_flow, &north_flow);
+
+    // Paths leave their first endpoint and enter their second one, and pass
+    // through every other cell.
+    int cells = width * height;
+    std::vector<int> first(pairs, -1);
+    for (int c = 0; c < cells; ++c) {
+      if (givens[c] >= 0 && first[givens[c]] < 0)
+        first[givens[c]] = c;
+    }
+    auto is_first = [&](int c) {
+      return givens[c] >= 0 && first[givens[c]] == c;
+    };
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        int c = i * width + j;
+        std::vector<Minisat::Lit> ins, outs;
+        for (int d = North; d <= West; ++d) {
+          ins.push_back(flow(i, j, static_cast<Direction>(d), true));
+          outs.push_back(flow(i, j, static_cast<Direction>(d)));
+        }
+        FoldedExact(is_first(c) ? 0 : 1, ins, options.degree_cardinality);
+        FoldedExact(givens[c] >= 0 && !is_first(c) ? 0 : 1, outs,
+                    options.degree_cardinality);
+      }
+    }
+
+    if (options.distance_encoding == DistanceEncoding::Binary)
+      SetUpBinaryDistanceConstraints(is_first);
+    else
+      SetUpOrderDistanceConstraints(is_first);
+  }
+
+  // distances[c][t - 1] holds iff cell c is at least t steps along its path,
+  // for 1 <= t < cells. A cell is at least as far as the nearest first
+  // endpoint, and at most cells - 1 less the way to the nearest second one.
+  template <typename F>
+  void SetUpOrderDistanceConstraints(F is_first) {
+    int cells = width * height;
+    auto nearest = [&](int c, bool first) {
+      int best = cells;
+      for (int d = 0; d < cells; ++d) {
+        if (givens[d] >= 0 && is_first(d) == first) {
+          best = std::min(best, std::abs(c / width - d / width) +
+                                std::abs(c % width - d % width));
+        }
+      }
+      return best;
+    };
+    for (int c = 0; c < cells; ++c) {
+      int low = is_first(c) ? 0 : nearest(c, true);
+      int high = is_first(c) ? 0 : cells - 1 - nearest(c, false);
+      std::vector<Minisat::Lit> xs;
+      for (int t = 1; t < cells; ++t)
+        xs.push_back(MakeLiteral(t <= low ? 1 : t > high ? 0 : -1));
+      for (int t = 1; t + 1 < cells; ++t)
+        folder.addClause(~xs[t], xs[t - 1]);
+      distances.push_back(std::move(xs));
+    }
+
+    auto at_least = [&](int c, int t) {
+      if (t <= 0)
+        return kTrue;
+      if (t >= cells)
+        return kFalse;
+      return distances[c][t - 1];
+    };
+    // f => (at_least(c, t) <=> at_least(d, t + 1)) for an edge f from c to d.
+    ForEachFlow([&](const Minisat::Lit& f, int c, int d) {
+      for (int t = 0; t < cells; ++t)
+        Glue(folder, f, at_least(c, t), at_least(d, t + 1));
+    });
+  }
+
+  // distances[c] holds the bits of the distance of cell c, and an edge from
+  // c to d requires those of d to be their successor, computed by a ripple
+  // carry per cell.
+  template <typename F>
+  void SetUpBinaryDistanceConstraints(F is_first) {
+    int cells = width * height;
+    int bits = LabelBits(cells);
+    std::vector<std::vector<Minisat::Lit>> successors;
+    std::vector<Minisat::Lit> overflows;
+    for (int c = 0; c < cells; ++c) {
+      std::vector<Minisat::Lit> xs, ys;
+      for (int b = 0; b < bits; ++b)
+        xs.push_back(MakeLiteral(is_first(c) ? 0 : -1));
+      // y_0 = ~x_0 with carry x_0; then y_b = x_b ^ carry and
+      // carry' = x_b & carry.
+      auto carry = xs[0];
+      ys.push_back(~xs[0]);
+      for (int b = 1; b < bits; ++b) {
+        auto y = MakeLiteral();
+        folder.addClause(~y, xs[b], carry);
+        folder.addClause(~y, ~xs[b], ~carry);
+        folder.addClause(y, ~xs[b], carry);
+        folder.addClause(y, xs[b], ~carry);
+        auto next = MakeLiteral();
+        folder.addClause(~next, xs[b]);
+        folder.addClause(~next, carry);
+        folder.addClause(next, ~xs[b], ~carry);
+        ys.push_back(y);
+        carry = next;
+      }
+      distances.push_back(std::move(xs));
+      successors.push_back(std::move(ys));
+      overflows.push_back(carry);
+    }
+
+    ForEachFlow([&](const Minisat::Lit& f, int c, int d) {
+      folder.addClause(~f, ~overflows[c]);
+      for (int b = 0; b < bits; ++b)
+        Glue(folder, f, distances[d][b], successors[c][b]);
+    });
+  }
+
+  // Calls |f| with each directed edge and the cells it goes from and to.
+  template <typename F>
+  void ForEachFlow(F f) const {
+    static const Direction kDirections[] = {North, South, East, West};
+    static const int kDi[] = {-1, 1, 0, 0};
+    static const int kDj[] = {0, 0, 1, -1};
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        for (int d = 0; d < 4; ++d) {
+          int ii = i + kDi[d], jj = j + kDj[d];
+          if (0 <= ii && ii < height && 0 <= jj && jj < width)
+            f(flow(i, j, kDirections[d]), i * width + j, ii * width + jj);
+        }
+      }
+    }
+  }
+
+  void SetUpCornerPropagationConstraints() {
+    Phase<Solver> phase(phases, "corner", solver);
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        if (i > 0 && j > 0)
+          CornerPropagation(i, j, North, West);
+        if (i > 0 && j < width - 1)
+          CornerPropagation(i, j, North, East);
+        if (i < height - 1 && j > 0)
+          CornerPropagation(i, j, South, West);
+        if (i < height - 1 && j < width - 1)
+          CornerPropagation(i, j, South, East);
+      }
+    }
+  }
+
+  void CornerPropagation(int i, int j, Direction in, Direction out) {
+    int ii = i + (in == North ? -1 : 1);
+    int jj = j + (out == West ? -1 : 1);
+
+    Corner(folder, edge(i, j, in), edge(i, j, out), edge(ii, jj, Sink),
+           edge(ii, jj, in), edge(ii, jj, out));
+  }
+
+  // Calls |f| with each literal that pins cell (i, j) to an endpoint of
+  // label |k|, or to no endpoint if |k| is negative.
+  template <typename F>
+  void ForEachGivenLiteral(int i, int j, int k, F f) {
+    if (k < 0) {
+      f(~edge(i, j, Sink));
+      return;
+    }
+    if (binary()) {
+      for (int b = 0; b < label_width; ++b)
+        f(label_bit(i, j, b, k));
+    } else if (!edges_only()) {
+      f(assignment(i, j, k));
+    }
+    f(edge(i, j, Sink));
+  }
+
+  // Runs the Deduction rules on the givens and calls |f| with each edge and
+  // label literal they fix. Returns false if they refute the board.
+  template <typename F>
+  bool Deduce(F f) {
+    Deduction rules(width, height, givens,
+                    options.connectivity == Connectivity::Spanning &&
+                        options.engine == Engine::Labels);
+    bool ok = rules.Run();
+    deduction = DeductionStats();
+    deduction.rounds = rules.rounds();
+    if (!ok)
+      return false;
+
+    auto fix = [&](const Minisat::Lit& e, Deduction::State state) {
+      if (IsConstant(e))
+        return;
+      ++deduction.edges;
+      if (state == Deduction::Unknown)
+        return;
+      ++deduction.fixed;
+      f(state == Deduction::On ? e : ~e);
+    };
+    for (size_t p = 0; p < east_west.size(); ++p)
+      fix(east_west[p], rules.east_west(p));
+    for (size_t p = 0; p < north_south.size(); ++p)
+      fix(north_south[p], rules.north_south(p));
+    deduction.complete = deduction.fixed == deduction.edges;
+
+    if (edges_only())
+      return true;
+    auto label = [&](const Minisat::Lit& x) {
+      if (!IsConstant(x))
+        f(x);
+    };
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        int k = rules.label(i * width + j);
+        if (k < 0)
+          continue;
+        if (binary()) {
+          for (int b = 0; b < label_width; ++b)
+            label(label_bit(i, j, b, k));
+          continue;
+        }
+        bool found = false;
+        ForEachAssignment(i, j, [&](int l, const Minisat::Lit& x) {
+          label(l == k ? x : ~x);
+          found |= l == k;
+        });
+        if (!found)
+          return false;
+      }
+    }
+    return true;
+  }
+
+  // Adds what the Deduction rules fix as units, or the empty clause if they
+  // refute the board.
+  void ApplyDeductions() {
+    Phase<Solver> phase(phases, "deduce", solver);
+    std::vector<Minisat::Lit> facts;
+    if (!Deduce([&](const Minisat::Lit& x) { facts.push_back(x); })) {
+      folder.addEmptyClause();
+      return;
+    }
+    for (auto& x : facts)
+      folder.addClause(x);
+    if (deduction.complete)
+      SetDeducedModel(facts);
+  }
+
+  // Makes |facts| and the givens the model for the next solve, which then
+  // skips the solver. They must decide every edge, label and sink.
+  void SetDeducedModel(const std::vector<Minisat::Lit>& facts) {
+    deduced.assign(solver.nVars(), l_Undef);
+    auto set = [&](const Minisat::Lit& x) {
+      if (!IsConstant(x))
+        deduced[Minisat::var(x)] = Minisat::lbool(!Minisat::sign(x));
+    };
+    for (auto& x : facts)
+      set(x);
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j)
+        ForEachGivenLiteral(i, j, givens[i * width + j], set);
+    }
+    deduced_model = true;
+  }
+
+  // Fill() and Empty() pin the givens by unit clauses, for instances built
+  // without constant folding.
+  void Fill(int i, int j, int k) {
+    ForEachGivenLiteral(i, j, k, [&](const Minisat::Lit& x) {
+      folder.addClause(x);
+    });
+  }
+
+  void Empty(int i, int j) {
+    Fill(i, j, -1);
+  }
+
+  // For each cell, the labels that can occupy it: those having a simple path
+  // between their two endpoints through the cell, avoiding other endpoints.
+  //
+  // Such a path exists iff the cell shares a biconnected component with a
+  // virtual edge between the endpoints, which is found by one Tarjan DFS per
+  // label rooted at one endpoint that takes the virtual edge first. Labels
+  // not appearing exactly twice keep every free cell.
+  static std::vector<std::vector<int>> ReachableDomains(
+      const std::vector<std::string>& input,
+      const std::vector<std::vector<int>>& endpoints,
+      int width, int height) {
+    int cells = width * height;
+    std::vector<std::vector<int>> domains(cells);
+    std::vector<int> disc(cells, -1), low(cells), visited, stack;
+    struct Frame {
+      int v, parent, next;
+    };
+    std::vector<Frame> frames;
+
+    for (size_t k = 0; k < endpoints.size(); ++k) {
+      auto& ends = endpoints[k];
+      if (ends.size() != 2) {
+        for (int c = 0; c < cells; ++c) {
+          if (input[c / width][c % width] == '.' ||
+              std::find(ends.begin(), ends.end(), c) != ends.end())
+            domains[c].push_back(k);
+        }
+        continue;
+      }
+
+      int s = ends[0], t = ends[1];
+      auto neighbor = [&](int v, int n) {
+        int i = v / width, j = v % width;
+        int w = -1;
+        switch (n) {
+          case 0: w = v == s ? t : v == t ? s : -1; break;
+          case 1: w = i > 0 ? v - width : -1; break;
+          case 2: w = i < height - 1 ? v + width : -1; break;
+          case 3: w = j < width - 1 ? v + 1 : -1; break;
+          case 4: w = j > 0 ? v - 1 : -1; break;
+        }
+        if (w < 0 || (w != s && w != t && input[w / width][w % width] != '.'))
+          return -1;
+        return w;
+      };
+
+      int time = 0;
+      auto discover = [&](int v, int parent) {
+        disc[v] = low[v] = time++;
+        visited.push_back(v);
+        stack.push_back(v);
+        frames.push_back(Frame{v, parent, 0});
+      };
+      discover(s, -1);
+      while (!frames.empty()) {
+        auto& f = frames.back();
+        if (f.next <= 4) {
+          int w = neighbor(f.v, f.next++);
+          if (w < 0 || w == f.parent)
+            continue;
+          if (disc[w] < 0)
+            discover(w, f.v);
+          else
+            low[f.v] = std::min(low[f.v], disc[w]);
+          continue;
+        }
+
+        int v = f.v;
+        frames.pop_back();
+        int p = frames.back().v;
+        low[p] = std::min(low[p], low[v]);
+        if (low[v] < disc[p])
+          continue;
+
+        // The vertices down to |v| form a block with |p|. Only the block
+        // under the virtual edge, where p == s and v == t, is kept.
+        int w;
+        do {
+          w = stack.back();
+          stack.pop_back();
+          if (p == s)
+            domains[w].push_back(k);
+        } while (w != v);
+        if (p == s) {
+          domains[s].push_back(k);
+          break;
+        }
+      }
+
+      frames.clear();
+      stack.clear();
+      for (int v : visited)
+        disc[v] = -1;
+      visited.clear();
+    }
+    return domains;
+  }
+
+  static std::unique_ptr<BasicInstance> read(std::istream& in,
+                                             const Options& options) {
+    auto start = std::chrono::steady_clock::now();
+    auto board = Parse(in);
+    std::chrono::duration<double, std::milli> parse_ms =
+        std::chrono::steady_clock::now() - start;
+    auto instance = Build(board, options);
+    instance->phases.Record("parse", parse_ms.count());
+    return instance;
+  }
+
+  static Board Parse(std::istream& in) {
+    std::vector<std::string> input;
+
+    std::vector<char> labels;
+    std::map<char, int> label_to_index;
+
+    std::string line;
+    while (std::getline(in, line)) {
+      if (line.empty() || line[0] == '#')
+        continue;
+      input.push_back(line);
+
+      for (char c : line) {
+        if (c == '.')
+          continue;
+        auto inserted = label_to_index.insert(std::make_pair(c, 0));
+        if (inserted.second) {
+          inserted.first->second = labels.size();
+          labels.push_back(c);
+        }
+      }
+    }
+
+    int pairs = labels.size();
+    int height = input.size();
+    int width = height ? input.front().size() : 0;
+
+    std::vector<int> givens(width * height, -1);
+    std::vector<std::vector<int>> endpoints(pairs);
+    for (int i = 0; i < height; ++i) {
+      assert(input[i].size() == width);
+      for (int j = 0; j < width; ++j) {
+        if (input[i][j] == '.')
+          continue;
+        givens[i * width + j] = label_to_index[input[i][j]];
+        endpoints[givens[i * width + j]].push_back(i * width + j);
+      }
+    }
+
+    Board board;
+    board.input = std::move(input);
+    board.labels = std::move(labels);
+    board.pairs = pairs;
+    board.width = width;
+    board.height = height;
+    board.givens = std::move(givens);
+    board.endpoints = std::move(endpoints);
+    return board;
+  }
+
+  static std::unique_ptr<BasicInstance> Build(const Board& board,
+                                              const Options& options) {
+    int pairs = board.pairs, width = board.width, height = board.height;
+    auto& givens = board.givens;
+    std::vector<std::vector<int>> domains;
+    auto start = std::chrono::steady_clock::now();
+    if (options.label_encoding == LabelEncoding::OneHot ||
+        options.engine == Engine::Edges) {
+      if (options.domains == Domains::Reachable) {
+        domains = ReachableDomains(board.input, board.endpoints, width,
+                                   height);
+      } else {
+        std::vector<int> all(pairs);
+        for (int k = 0; k < pairs; ++k)
+          all[k] = k;
+        domains.assign(width * height, all);
+      }
+    }
+
+    std::chrono::duration<double, std::milli> domains_ms =
+        std::chrono::steady_clock::now() - start;
+
+    auto instance = std::make_unique<BasicInstance>(
+        options, board.labels, pairs, width, height, givens, domains);
+    instance->phases.Record("domains", domains_ms.count());
+    instance->SetUpConstraints();
+
+    if (!options.fold_constants) {
+      for (int i = 0; i < height; ++i) {
+        for (int j = 0; j < width; ++j) {
+          if (givens[i * width + j] < 0)
+            instance->Empty(i, j);
+          else
+            instance->Fill(i, j, givens[i * width + j]);
+        }
+      }
+    }
+    if (options.deduce)
+      instance->ApplyDeductions();
+    instance->Simplify();
+    Connect(*instance);
+
+    return instance;
+  }
+
+  void SetUpConstraints() {
+    SetUpBasicConstraints();
+    if (options.connectivity == Connectivity::Spanning &&
+        options.engine == Engine::Labels)
+      SetUpSpanningUniqueConstraints();
+    if (options.connectivity == Connectivity::Distance)
+      SetUpDistanceConstraints();
+  }
+
+  // Whether Template() can stand in for Build() under |options|. The edges
+  // engine and distance connectivity add clauses that depend on where the
+  // givens are, so they cannot.
+  static bool HasTemplate(const Options& options) {
+    return options.engine == Engine::Labels &&
+           options.connectivity != Connectivity::Distance;
+  }
+
+  // An instance for every board of the given shape. It has no givens, full
+  // domains and no folding, and only clauses that hold whatever the givens
+  // are, so it can solve board after board with Assume().
+  static std::unique_ptr<BasicInstance> Template(const Options& options,
+                                                 int pairs, int width,
+                                                 int height) {
+    assert(HasTemplate(options));
+    Options shape = options;
+    shape.domains = Domains::Full;
+    shape.fold_constants = false;
+    std::vector<int> all(pairs);
+    for (int k = 0; k < pairs; ++k)
+      all[k] = k;
+    std::vector<std::vector<int>> domains;
+    if (shape.label_encoding == LabelEncoding::OneHot)
+      domains.assign(width * height, all);
+
+    auto instance = std::make_unique<BasicInstance>(
+        shape, std::vector<char>(pairs, '?'), pairs, width, height,
+        std::vector<int>(width * height, -1), domains);
+    instance->SetUpConstraints();
+    instance->Simplify();
+    return instance;
+  }
+
+  // Takes the labels and givens of |board|, which has the shape of this
+  // template, and sets |assumptions| to the literals that pin them and those
+  // the Deduction rules fix. Returns false if the rules refute the board.
+  bool Assume(const Board& board, std::vector<Minisat::Lit>* assumptions) {
+    assert(board.width == width && board.height == height);
+    assert(board.pairs == pairs);
+    labels = board.labels;
+    givens = board.givens;
+    refinement = RefinementStats();
+    assumptions->clear();
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        ForEachGivenLiteral(i, j, givens[i * width + j],
+                            [&](const Minisat::Lit& x) {
+                              assumptions->push_back(x);
+                            });
+      }
+    }
+    if (!options.deduce)
+      return true;
+
+    std::vector<Minisat::Lit> facts;
+    if (!Deduce([&](const Minisat::Lit& x) { facts.push_back(x); }))
+      return false;
+    for (auto& x : facts)
+      assumptions->push_back(x);
+    if (deduction.complete)
+      SetDeducedModel(facts);
+    return true;
+  }
+
+  // The value of |x| in the last model.
+  bool value(const Minisat::Lit& x) const {
+    if (IsConstant(x))
+      return x == kTrue;
+    if (!last_deduced)
+      return solver.value(x);
+    int i = Minisat::toInt(deduced[Minisat::var(x)] ^ Minisat::sign(x));
+    assert(i != 2);
+    return i == 0;
+  }
+
+  // Follows the edges of the last model from cell |c| and calls |f| with
+  // each cell until it meets a cell marked in |seen| or a dead end, marking
+  // the cells it passes.
+  template <typename F>
+  void Trace(int c, std::vector<char>* seen, F f) const {
+    static const Direction kDirections[] = {North, South, East, West};
+    static const int kDi[] = {-1, 1, 0, 0};
+    static const int kDj[] = {0, 0, 1, -1};
+    int from = -1;
+    while (!(*seen)[c]) {
+      (*seen)[c] = true;
+      f(c);
+      int i = c / width, j = c % width, next = -1;
+      for (int d = 0; d < 4 && next < 0; ++d) {
+        int n = (i + kDi[d]) * width + j + kDj[d];
+        if (n != from && value(edge(i, j, kDirections[d])))
+          next = n;
+      }
+      if (next < 0)
+        return;
+      from = c;
+      c = next;
+    }
+  }
+
+  // The paths of the last model, each as the list of its cells from one
+  // endpoint to the other.
+  std::vector<std::vector<int>> Paths() const {
+    std::vector<char> seen(width * height);
+    std::vector<std::vector<int>> paths;
+    for (int c = 0; c < width * height; ++c) {
+      if (seen[c] || !value(sinks[c]))
+        continue;
+      std::vector<int> path;
+      Trace(c, &seen, [&](int d) { path.push_back(d); });
+      paths.push_back(std::move(path));
+    }
+    return paths;
+  }
+
+  // The closed loops of the last model, each as the list of its cells. They
+  // are what remains after tracing the paths from every endpoint.
+  std::vector<std::vector<int>> Cycles() const {
+    std::vector<char> seen(width * height);
+    for (int c = 0; c < width * height; ++c) {
+      if (value(sinks[c]))
+        Trace(c, &seen, [](int) {});
+    }
+
+    std::vector<std::vector<int>> cycles;
+    for (int c = 0; c < width * height; ++c) {
+      if (seen[c])
+        continue;
+      std::vector<int> cycle;
+      Trace(c, &seen, [&](int d) { cycle.push_back(d); });
+      cycles.push_back(std::move(cycle));
+    }
+    return cycles;
+  }
+
+  // The edge between adjacent cells |c| and |d|.
+  const Minisat::Lit& edge_between(int c, int d) const {
+    int i = c / width, j = c % width;
+    if (d == c - width)
+      return edge(i, j, North);
+    if (d == c + width)
+      return edge(i, j, South);
+    return edge(i, j, d == c + 1 ? East : West);
+  }
+
+  // Excludes the path through |cells|, which joins two different labels.
+  void CutPath(const std::vector<int>& cells) {
+    Minisat::vec<Minisat::Lit> clause;
+    for (size_t t = 0; t + 1 < cells.size(); ++t)
+      clause.push(~edge_between(cells[t], cells[t + 1]));
+    folder.addClause(clause);
+    ++refinement.cuts;
+  }
+
+  // Requires an endpoint among |cells| or some edge leaving them. This holds
+  // in every solution, since paths through cells without endpoints must end
+  // elsewhere, and it excludes any closed loop on exactly these cells.
+  void CutCycle(const std::vector<int>& cells) {
+    static const Direction kDirections[] = {North, South, East, West};
+    static const int kDi[] = {-1, 1, 0, 0};
+    static const int kDj[] = {0, 0, 1, -1};
+    std::vector<char> inside(width * height);
+    for (int c : cells)
+      inside[c] = true;
+
+    Minisat::vec<Minisat::Lit> clause;
+    for (int c : cells) {
+      int i = c / width, j = c % width;
+      clause.push(sinks[c]);
+      for (int d = 0; d < 4; ++d) {
+        int ii = i + kDi[d], jj = j + kDj[d];
+        if (0 <= ii && ii < height && 0 <= jj && jj < width &&
+            !inside[ii * width + jj])
+          clause.push(edge(i, j, kDirections[d]));
+      }
+    }
+    folder.addClause(clause);
+    ++refinement.cuts;
+  }
+
+  // Excludes the last model's edges. Every solution has the same number of
+  // edges, so another one must drop one of them.
+  void BlockSolution() {
+    Minisat::vec<Minisat::Lit> clause;
+    for (auto* edges : {&east_west, &north_south}) {
+      for (auto& e : *edges) {
+        if (!IsConstant(e) && value(e))
+          clause.push(~e);
+      }
+    }
+    folder.addClause(clause);
+  }
+
+  void show(std::ostream& out) {
+    Render(out, labels, width, height,
+           [&](int i, int j, Direction d) { return value(edge(i, j, d)); },
+           [&](int i, int j) { return label(i, j); });
+  }
+
+  // The label of cell (i, j) in the last model.
+  int label(int i, int j) const {
+    if (edges_only())
+      return givens[i * width + j];
+    int k = 0;
+    if (binary()) {
+      for (int b = 0; b < label_width; ++b) {
+        if (value(assignments[(i * width + j) * label_width + b]))
+          k |= 1 << b;
+      }
+      return k;
+    }
+    ForEachAssignment(i, j, [&](int l, const Minisat::Lit& x) {
+      if (value(x))
+        k = l;
+    });
+    return k;
+  }
+
+  // Draws a solution, given which edges |on(i, j, d)| holds for and the
+  // |label(i, j)| of each endpoint.
+  template <typename F, typename G>
+  static void Render(std::ostream& out, const std::vector<char>& labels,
+                     int width, int height, F on, G label) {
+    for (int i = 0; i < height; ++i) {
+      for (int j = 0; j < width; ++j) {
+        if (on(i, j, Sink)) {
+          out << labels[label(i, j)];
+          continue;
+        }
+
+        int line = 0;
+        if (on(i, j, North))
+          line |= 1;
+        if (on(i, j, South))
+          line |= 2;
+        if (on(i, j, East))
+          line |= 4;
+        if (on(i, j, West))
+          line |= 8;
+        switch (line) {
+          case 3: out << u8"\u2502"; break;
+          case 5: out << u8"\u2514"; break;
+          case 9: out << u8"\u2518"; break;
+          case 6: out << u8"\u250c"; break;
+          case 10: out << u8"\u2510"; break;
+          case 12: out << u8"\u2500"; break;
+          default: out << " "; break;
+        }
+      }
+      out << '\n';
+    }
+  }
+};
+
+typedef BasicInstance<SharingBackend> Instance;
+
+// The milliseconds since |start|.
+double MillisecondsSince(std::chrono::steady_clock::time_point start);
+
+// Whether models of |options| may need refining by RefineModel().
+bool IsLazy(const Options& options);
+
+// What to print when |options| find no solution: under the spanning
+// shortcuts that only means there is no unique one.
+const char* NoSolution(const Options& options);
+
+// Solves |instance| lazily excluding what the CNF allows but solutions do
+// not: each model is traced, its closed loops (and with the edges engine,
+// its mislinked paths) are cut, and the warm solver is re-run until none is
+// left. Defined for Instance; number_link.cc has the other backends.
+template <typename Solver>
+bool SolveWithoutCycles(BasicInstance<Solver>& instance,
+                        const std::vector<Minisat::Lit>& assumptions);
+template <typename Solver>
+bool SolveWithoutCycles(BasicInstance<Solver>& instance);
+
+// Writes |phases| as one JSON line where --stats asks. Returns false,
+// having said so on stderr, if --stats-file failed.
+bool WriteStats(const PhaseStats& phases, const Options& options);
+
+#ifdef NUMBER_LINK_HAVE_IPASIR
+const bool kHaveIpasir = true;
+#else
+const bool kHaveIpasir = false;
+#endif
+
+// Builds |board|, parsed in |parse_ms|, on options.backend and solves it:
+// draws the solution, checks it for uniqueness or enumerates all, as the
+// options say. Backend::Compare builds and solves it on each backend in
+// turn, and draws Minisat's solution.
+int RunSingle(const Board& board, const Options& options, double parse_ms);
+
+// Solves |board| with BitboardSolver and draws the solution to |out|.
+// Returns whether there is one.
+bool SolveBitboard(const Board& board, const Options& options,
+                   BitboardSolver::Stats* stats, std::ostream& out);
+
+// A puzzle of a batch, named after where it was read.
+struct Puzzle {
+  std::string name;
+  std::string text;
+};
+
+// Loads puzzles from |path|: "-" for stdin, a directory of puzzle files, a
+// list of puzzle files as "@list", or a file holding one or more puzzles.
+bool LoadPuzzles(const std::string& path, std::vector<Puzzle>* puzzles);
+
+// |s| as a JSON string, quoted and escaped.
+std::string JsonString(const std::string& s);
+
+// Whether the rows of |text|, other than blank and comment lines, are all
+// as wide, which Instance::Parse() takes for granted.
+bool IsRectangular(const std::string& text);
+
+// Solves the puzzles of options.batch on options.threads workers and
+// writes a JSON line for each, in order.
+int RunBatch(Options options);
+
+// Solves the stdin puzzle on options.portfolio diversified solvers that
+// share short learnt clauses, and draws the solution of the first to finish.
+int RunPortfolio(const Options& options);
+
+// Splits the stdin puzzle into 2^depth cubes over central edge variables
+// and solves them under assumptions on a pool of workers, each reusing one
+// Instance. A cube that exceeds its conflict budget is split again on the
+// next variable, and all work is cancelled as soon as one cube is SAT.
+int RunCubes(const Options& options);
+
+// Counts every solution of |board| with FrontierCounter, then prints them
+// as Enumerate() does, or the first as the solvers do.
+int RunFrontier(const Board& board, const Options& options);
+
+// Describes the options ParseOptions() takes on stderr.
+void Usage(const char* argv0);
+
+// Reads the options of |argv| into |options|. Returns false on one it does
+// not know or whose value it cannot read.
+bool ParseOptions(int argc, char** argv, Options* options);
+
+#endif  // NUMBER_LINK_NUMBER_LINK_H_
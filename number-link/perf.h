@@ -0,0 +1,159 @@
+#ifndef NUMBER_LINK_PERF_H_
+#define NUMBER_LINK_PERF_H_
+
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Hardware counters of the calling thread, in user space, through Linux
+// perf_event_open(2). They are opened as one group, so that they count over
+// the same instructions, around the code between Start() and Stop().
+//
+// Where perf events are not allowed (perf_event_paranoid, containers), the
+// CPU has no PMU exposed (most VMs) or the system is not Linux, available()
+// is false and Stop() reads -1 for every counter; a counter the CPU lacks
+// reads -1 on its own.
+
+class PerfCounters {
+ public:
+  enum Counter {
+    kCycles,
+    kInstructions,
+    kLlcMisses,
+    kBranchMisses,
+    kDtlbMisses,
+    kCounters
+  };
+  typedef std::array<int64_t, kCounters> Values;
+
+  static const char* Name(int counter) {
+    static const char* const names[] = {"cycles", "instructions",
+                                        "llc_misses", "branch_misses",
+                                        "dtlb_misses"};
+    return names[counter];
+  }
+
+  static Values Unavailable() {
+    Values values;
+    values.fill(-1);
+    return values;
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+#ifdef __linux__
+  PerfCounters() {
+    fds_.fill(-1);
+    for (int c = 0; c < kCounters; ++c) {
+      perf_event_attr attr;
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      SetEvent(c, &attr);
+      attr.disabled = c == kCycles;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format =
+          PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds_[c] = syscall(__NR_perf_event_open, &attr, 0, -1,
+                        c == kCycles ? -1 : fds_[kCycles], 0);
+      if (c == kCycles && fds_[c] < 0) {
+        error_ = std::strerror(errno);
+        return;
+      }
+    }
+  }
+
+  ~PerfCounters() {
+    for (int fd : fds_) {
+      if (fd >= 0)
+        close(fd);
+    }
+  }
+
+  bool available() const { return fds_[kCycles] >= 0; }
+
+  // Why the counters are not available().
+  const std::string& error() const { return error_; }
+
+  void Start() {
+    if (!available())
+      return;
+    ioctl(fds_[kCycles], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ioctl(fds_[kCycles], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  // The counts since Start(), scaled up if the group was multiplexed with
+  // others for part of the time.
+  Values Stop() {
+    Values values = Unavailable();
+    if (!available())
+      return values;
+    ioctl(fds_[kCycles], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+    for (int c = 0; c < kCounters; ++c) {
+      uint64_t read_values[3];  // value, time enabled, time running
+      if (fds_[c] < 0 ||
+          read(fds_[c], read_values, sizeof(read_values)) !=
+              sizeof(read_values) ||
+          read_values[2] == 0)
+        continue;
+      values[c] = static_cast<int64_t>(static_cast<double>(read_values[0]) *
+                                       read_values[1] / read_values[2]);
+    }
+    return values;
+  }
+
+ private:
+  static void SetEvent(int counter, perf_event_attr* attr) {
+    // Read misses, as perf's LLC-load-misses and dTLB-load-misses.
+    auto read_misses = [](__u64 cache) {
+      return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+             (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    };
+    attr->type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+      case kCycles:
+        attr->config = PERF_COUNT_HW_CPU_CYCLES;
+        break;
+      case kInstructions:
+        attr->config = PERF_COUNT_HW_INSTRUCTIONS;
+        break;
+      case kLlcMisses:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = read_misses(PERF_COUNT_HW_CACHE_LL);
+        break;
+      case kBranchMisses:
+        attr->config = PERF_COUNT_HW_BRANCH_MISSES;
+        break;
+      default:
+        attr->type = PERF_TYPE_HW_CACHE;
+        attr->config = read_misses(PERF_COUNT_HW_CACHE_DTLB);
+        break;
+    }
+  }
+
+  std::array<int, kCounters> fds_;
+  std::string error_;
+#else
+  PerfCounters() {}
+
+  bool available() const { return false; }
+  const std::string& error() const { return error_; }
+  void Start() {}
+  Values Stop() { return Unavailable(); }
+
+ private:
+  std::string error_ = "perf events need Linux";
+#endif
+};
+
+#endif  // NUMBER_LINK_PERF_H_
@@ -0,0 +1,166 @@
+#ifndef NUMBER_LINK_STATS_H_
+#define NUMBER_LINK_STATS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <sys/resource.h>
+
+// Timers and counters for --stats: how long each phase took and how many
+// variables, clauses and root units it added to the solver, plus named
+// counters such as the solver's conflicts.
+//
+// Nothing is recorded unless Enable()d, which costs a branch per
+// phase. Building with -DNUMBER_LINK_NO_STATS removes even that: PhaseStats
+// keeps no state, and Phase is an empty object.
+
+#ifdef NUMBER_LINK_NO_STATS
+const bool kHaveStats = false;
+#else
+const bool kHaveStats = true;
+#endif
+
+class PhaseStats {
+ public:
+  struct Entry {
+    std::string name;
+    int64_t calls = 0;
+    double ms = 0;
+    int64_t vars = 0, clauses = 0, units = 0;
+  };
+
+#ifndef NUMBER_LINK_NO_STATS
+  void Enable(bool on) { enabled_ = on; }
+  bool enabled() const { return enabled_; }
+
+  // Adds one run of phase |name|.
+  void Record(const char* name, double ms, int64_t vars = 0,
+              int64_t clauses = 0, int64_t units = 0) {
+    if (!enabled_)
+      return;
+    auto& e = Find(name);
+    ++e.calls;
+    e.ms += ms;
+    e.vars += vars;
+    e.clauses += clauses;
+    e.units += units;
+  }
+
+  void Count(const char* name, int64_t value) {
+    if (enabled_)
+      counters_.emplace_back(name, value);
+  }
+
+  // The phases in order of first run.
+  const std::vector<Entry>& phases() const { return phases_; }
+
+  // Forgets what was recorded, as a reused solver starts its next puzzle.
+  void Clear() {
+    phases_.clear();
+    counters_.clear();
+  }
+
+  // Writes the phases in order of first run, the counters and the peak
+  // resident set as one JSON object.
+  void Json(std::ostream& out) const {
+    out << "{\"phases\":{";
+    for (size_t i = 0; i < phases_.size(); ++i) {
+      auto& e = phases_[i];
+      out << (i ? "," : "") << "\"" << e.name << "\":{\"calls\":" << e.calls
+          << ",\"ms\":" << e.ms;
+      if (e.vars || e.clauses || e.units) {
+        out << ",\"vars\":" << e.vars << ",\"clauses\":" << e.clauses
+            << ",\"units\":" << e.units;
+      }
+      out << "}";
+    }
+    out << "},\"counters\":{";
+    for (size_t i = 0; i < counters_.size(); ++i) {
+      out << (i ? "," : "") << "\"" << counters_[i].first
+          << "\":" << counters_[i].second;
+    }
+    out << "},\"peak_rss_kb\":" << PeakRssKb() << "}";
+  }
+#else
+  void Enable(bool) {}
+  bool enabled() const { return false; }
+  void Record(const char*, double, int64_t = 0, int64_t = 0, int64_t = 0) {}
+  void Count(const char*, int64_t) {}
+  void Clear() {}
+  std::vector<Entry> phases() const { return std::vector<Entry>(); }
+  void Json(std::ostream& out) const { out << "{}"; }
+#endif
+
+  // The peak resident set of the process so far.
+  static int64_t PeakRssKb() {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage))
+      return -1;
+    return usage.ru_maxrss;
+  }
+
+#ifndef NUMBER_LINK_NO_STATS
+ private:
+  Entry& Find(const char* name) {
+    for (auto& e : phases_) {
+      if (e.name == name)
+        return e;
+    }
+    phases_.emplace_back();
+    phases_.back().name = name;
+    return phases_.back();
+  }
+
+  bool enabled_ = false;
+  std::vector<Entry> phases_;
+  std::vector<std::pair<const char*, int64_t>> counters_;
+#endif
+};
+
+// Records the scope it lives in as a run of phase |name|, with what
+// |solver| gained meanwhile.
+template <typename Solver>
+class Phase {
+ public:
+#ifndef NUMBER_LINK_NO_STATS
+  Phase(PhaseStats& stats, const char* name, const Solver& solver)
+      : stats_(stats), name_(name), solver_(solver) {
+    if (!stats.enabled())
+      return;
+    vars_ = solver.nVars();
+    clauses_ = solver.nClauses();
+    units_ = solver.nAssigns();
+    start_ = std::chrono::steady_clock::now();
+  }
+
+  ~Phase() {
+    if (!stats_.enabled())
+      return;
+    std::chrono::duration<double, std::milli> ms =
+        std::chrono::steady_clock::now() - start_;
+    stats_.Record(name_, ms.count(), solver_.nVars() - vars_,
+                  solver_.nClauses() - clauses_,
+                  solver_.nAssigns() - units_);
+  }
+#else
+  Phase(PhaseStats&, const char*, const Solver&) {}
+#endif
+
+  Phase(const Phase&) = delete;
+  Phase& operator=(const Phase&) = delete;
+
+#ifndef NUMBER_LINK_NO_STATS
+ private:
+  PhaseStats& stats_;
+  const char* name_;
+  const Solver& solver_;
+  int64_t vars_ = 0, clauses_ = 0, units_ = 0;
+  std::chrono::steady_clock::time_point start_;
+#endif
+};
+
+#endif  // NUMBER_LINK_STATS_H_